@@ -0,0 +1,57 @@
+#define _GNU_SOURCE
+#include "affinity.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+int* affinity_cpus(int* count) {
+    long configured = sysconf(_SC_NPROCESSORS_CONF);
+    int max_cpus = configured > CPU_SETSIZE ? (int)configured : CPU_SETSIZE;
+
+    cpu_set_t* set = CPU_ALLOC(max_cpus);
+    size_t set_size = CPU_ALLOC_SIZE(max_cpus);
+    if (set != NULL) CPU_ZERO_S(set_size, set);
+
+    int* cpus;
+    if (set == NULL || sched_getaffinity(0, set_size, set) != 0) {
+        perror("Error getting CPU affinity");
+        cpus = (int*)malloc(sizeof(int));
+        cpus[0] = 0;
+        *count = 1;
+        if (set != NULL) CPU_FREE(set);
+        return cpus;
+    }
+
+    cpus = (int*)malloc(CPU_COUNT_S(set_size, set) * sizeof(int));
+    *count = 0;
+    for (int cpu = 0; cpu < max_cpus; ++cpu) {
+        if (CPU_ISSET_S(cpu, set_size, set)) cpus[(*count)++] = cpu;
+    }
+
+    CPU_FREE(set);
+    return cpus;
+}
+
+int pin_current_thread(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0) {
+        fprintf(stderr, "Error pinning thread to CPU %d: %s\n", cpu, strerror(err));
+        return -1;
+    }
+    return 0;
+}
+
+// getcpu(3) из glibc идёт через vDSO, без перехода в ядро на каждом попадании
+int current_numa_node() {
+    unsigned int cpu, node;
+    if (getcpu(&cpu, &node) != 0) return 0;
+    return (int)node;
+}
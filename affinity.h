@@ -0,0 +1,16 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+// Отдельный слушающий сокет и поток accept на каждое ядро: соединение
+// обслуживается на том ядре, куда пришли его пакеты (SO_INCOMING_CPU),
+// а память под ответы выделяется на NUMA-узле этого ядра (first touch)
+#define PROXY_CPU_PINNING 0
+
+// Возвращает массив номеров всех доступных процессу ядер (освобождать
+// через free) и их число в count. Размер берётся из системы, а не из
+// константы: на двухсокетной машине ядра второго узла идут после первых 64
+int* affinity_cpus(int* count);
+int pin_current_thread(int cpu);
+int current_numa_node();
+
+#endif //AFFINITY_H
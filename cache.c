@@ -2,16 +2,22 @@
 
 void init_cache(Cache* cache) {
     pthread_mutex_init(&cache->cache_global_mutex, NULL);
+    cache->local_hits = cache->remote_hits = 0;
     
     for (int i = 0; i < MAX_CACHE_SIZE; i++) {
-        memset(cache->cache[i].url, '\0', MAX_URL_LEN);
+        cache->cache[i].url = NULL;
+        cache->cache[i].key_hash = 0;
 
         cache->cache[i].data = (Data*)malloc(sizeof(Data));
         cache->cache[i].data->memory = NULL;
         cache->cache[i].data->size = 0;
 
         cache->cache[i].LRU = 0;
+        cache->cache[i].expires = 0;
+        cache->cache[i].status_code = 0;
         cache->cache[i].is_error = cache->cache[i].is_loading = cache->cache[i].is_size_full = 0;
+        cache->cache[i].numa_node = 0;
+        cache->cache[i].refs = 0;
 
         pthread_mutex_init(&cache->cache[i].elem_mutex, NULL);
         pthread_cond_init(&cache->cache[i].loading_cond, NULL);
@@ -32,6 +38,7 @@ void destroy_cache(Cache* cache) {
                 free(cache->cache[i].data->memory);
             free(cache->cache[i].data);
         }
+        free(cache->cache[i].url);
         
         pthread_mutex_unlock(&cache->cache[i].elem_mutex);
         pthread_mutex_destroy(&cache->cache[i].elem_mutex);
@@ -42,12 +49,39 @@ void destroy_cache(Cache* cache) {
     free(cache);
 }
 
-void delete_item(const char* url, Cache* cache) {
-    CacheItem* item = atomic_find_or_add_url(cache, url);
+// Вызывается под cache_global_mutex. url и key_hash меняются только под
+// глобальной блокировкой, поэтому поиск не берёт elem_mutex и читает
+// лишь первую кеш-линию каждого элемента
+static CacheItem* find_item(Cache* cache, const char* url, uint64_t key_hash) {
+    for (int i = 0; i < MAX_CACHE_SIZE; ++i) {
+        // Сначала сравниваем хеши, строки - только при совпадении
+        if (cache->cache[i].key_hash == key_hash &&
+            cache->cache[i].url != NULL &&
+            strcmp(cache->cache[i].url, url) == 0) {
+            return &cache->cache[i];
+        }
+    }
+    return NULL;
+}
 
-    if (item == NULL || strcmp(item->url, "") == 0) return;
+// Закреплённый или загружаемый элемент не удаляется: освободившийся слот
+// сразу получил бы другой ключ, пока с ним ещё работает другой поток
+int delete_item(const char* url, Cache* cache) {
+    pthread_mutex_lock(&cache->cache_global_mutex);
+
+    CacheItem* item = find_item(cache, url, hash_cache_key(url, strlen(url)));
+    if (item == NULL) {
+        pthread_mutex_unlock(&cache->cache_global_mutex);
+        return 0;
+    }
 
     pthread_mutex_lock(&item->elem_mutex);
+    if (item->is_loading || __atomic_load_n(&item->refs, __ATOMIC_ACQUIRE) > 0) {
+        pthread_mutex_unlock(&item->elem_mutex);
+        pthread_mutex_unlock(&cache->cache_global_mutex);
+        return -1;
+    }
+
     if (item->data != NULL) {
         if (item->data->memory != NULL) {
             free(item->data->memory);
@@ -55,32 +89,30 @@ void delete_item(const char* url, Cache* cache) {
         }
         item->data->size = 0;
     }
-    memset(item->url, '\0', MAX_URL_LEN);
+    free(item->url);
+    item->url = NULL;
+    item->key_hash = 0;
+    item->expires = 0;
+    item->status_code = 0;
     item->is_error = 0;
     item->is_loading = 0;
     item->is_size_full = 0;
     pthread_cond_broadcast(&item->loading_cond);
     pthread_mutex_unlock(&item->elem_mutex);
+
+    pthread_mutex_unlock(&cache->cache_global_mutex);
+    return 0;
 }
 
 CacheItem* atomic_find_or_add_url(Cache* cache, const char* url) {
+    uint64_t key_hash = hash_cache_key(url, strlen(url));
+
     pthread_mutex_lock(&cache->cache_global_mutex);
     
-    CacheItem* item = NULL;
-    
     // Сначала ищем существующий URL
-    for (int i = 0; i < MAX_CACHE_SIZE; ++i) {
-        pthread_mutex_lock(&cache->cache[i].elem_mutex);
-        
-        if (strcmp(cache->cache[i].url, "") != 0 && 
-            strcmp(cache->cache[i].url, url) == 0) {
-            item = &cache->cache[i];
-            item->LRU = time(NULL);
-            pthread_mutex_unlock(&cache->cache[i].elem_mutex);
-            break;
-        }
-        
-        pthread_mutex_unlock(&cache->cache[i].elem_mutex);
+    CacheItem* item = find_item(cache, url, key_hash);
+    if (item != NULL) {
+        item->LRU = time(NULL);
     }
     
     // Если не нашли - добавляем новый
@@ -89,27 +121,25 @@ CacheItem* atomic_find_or_add_url(Cache* cache, const char* url) {
         
         // Ищем свободный слот
         for (int i = 0; i < MAX_CACHE_SIZE; ++i) {
-            pthread_mutex_lock(&cache->cache[i].elem_mutex);
-            
-            if (strcmp(cache->cache[i].url, "") == 0) {
-                pthread_mutex_unlock(&cache->cache[i].elem_mutex);
+            if (cache->cache[i].url == NULL) {
                 index = i;
                 break;
             }
-            
-            pthread_mutex_unlock(&cache->cache[i].elem_mutex);
         }
         
-        // Если нет свободных - ищем LRU
+        // Если нет свободных - ищем LRU среди незакреплённых и незагружаемых:
+        // закреплённый элемент сейчас читает другой поток, а данные
+        // загружаемого ещё пишет поток загрузки
         if (index == -1) {
-            int minInd = 0;
+            int minInd = -1;
             time_t min = 0;
             int first = 1;
             
             for (int i = 0; i < MAX_CACHE_SIZE; ++i) {
                 pthread_mutex_lock(&cache->cache[i].elem_mutex);
                 
-                if (strcmp(cache->cache[i].url, "") == 0) {
+                if (cache->cache[i].url == NULL || cache->cache[i].is_loading ||
+                    __atomic_load_n(&cache->cache[i].refs, __ATOMIC_ACQUIRE) > 0) {
                     pthread_mutex_unlock(&cache->cache[i].elem_mutex);
                     continue;
                 }
@@ -126,6 +156,10 @@ CacheItem* atomic_find_or_add_url(Cache* cache, const char* url) {
                 pthread_mutex_unlock(&cache->cache[i].elem_mutex);
             }
             
+            if (minInd == -1) {
+                pthread_mutex_unlock(&cache->cache_global_mutex);
+                return NULL;
+            }
             index = minInd;
             
             // Очищаем старый элемент
@@ -141,6 +175,8 @@ CacheItem* atomic_find_or_add_url(Cache* cache, const char* url) {
             }
             
             // Сбрасываем флаги
+            cache->cache[index].expires = 0;
+            cache->cache[index].status_code = 0;
             cache->cache[index].is_loading = 0;
             cache->cache[index].is_error = 0;
             cache->cache[index].is_size_full = 0;
@@ -159,8 +195,12 @@ CacheItem* atomic_find_or_add_url(Cache* cache, const char* url) {
         
         // Занимаем слот
         pthread_mutex_lock(&cache->cache[index].elem_mutex);
-        strcpy(cache->cache[index].url, url);
+        free(cache->cache[index].url);
+        cache->cache[index].url = strdup(url);
+        cache->cache[index].key_hash = key_hash;
         cache->cache[index].LRU = time(NULL);
+        cache->cache[index].expires = 0;
+        cache->cache[index].status_code = 0;
         cache->cache[index].is_loading = 0;
         cache->cache[index].is_error = 0;
         cache->cache[index].is_size_full = 0;
@@ -168,7 +208,72 @@ CacheItem* atomic_find_or_add_url(Cache* cache, const char* url) {
         
         item = &cache->cache[index];
     }
+
+    // Закрепляем под глобальной блокировкой, иначе между возвратом и
+    // is_loading = 1 слот мог бы достаться другому ключу
+    __atomic_add_fetch(&item->refs, 1, __ATOMIC_ACQ_REL);
     
     pthread_mutex_unlock(&cache->cache_global_mutex);
     return item;
 }
+
+// Снимает закрепление, полученное из atomic_find_or_add_url. Новые
+// закрепления появляются только под cache_global_mutex, так что вытеснение
+// видит либо актуальное значение, либо завышенное - это безопасно
+void release_item(CacheItem* item) {
+    __atomic_sub_fetch(&item->refs, 1, __ATOMIC_ACQ_REL);
+}
+
+// Сколько секунд хранить ответ с ошибкой, 0 - не кешировать
+int negative_ttl(int status_code) {
+    if (status_code == 404 || status_code == 410) return NEGATIVE_TTL_NOT_FOUND_SEC;
+    if (status_code >= 500 && status_code <= 599) return NEGATIVE_TTL_SERVER_ERROR_SEC;
+    return 0;
+}
+
+// Вызывается под elem_mutex. Освобождает данные устаревшего элемента,
+// чтобы его загрузили заново; возвращает 1, если элемент устарел
+int drop_expired_data(CacheItem* item) {
+    if (item->is_loading || item->expires == 0 || item->expires > time(NULL)) return 0;
+
+    if (item->data->memory != NULL) {
+        free(item->data->memory);
+        item->data->memory = NULL;
+    }
+    item->data->size = 0;
+    item->expires = 0;
+    item->status_code = 0;
+    return 1;
+}
+
+// Вызывается под elem_mutex при отдаче данных из кеша. Без закрепления
+// потоков планировщик переносит их между ядрами, и узел в момент загрузки
+// ничего не говорит о том, где лежит память, поэтому счётчики не ведутся
+void count_numa_hit(Cache* cache, CacheItem* item) {
+#if PROXY_CPU_PINNING
+    if (item->numa_node == current_numa_node()) {
+        __atomic_fetch_add(&cache->local_hits, 1, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_add(&cache->remote_hits, 1, __ATOMIC_RELAXED);
+    }
+#else
+    (void)cache;
+    (void)item;
+#endif
+}
+
+size_t cache_stats(Cache* cache, char* buffer, size_t size) {
+    if (size == 0) return 0;
+
+#if PROXY_CPU_PINNING
+    int written = snprintf(buffer, size, "cache numa_local_hits=%lu numa_remote_hits=%lu\n",
+                           __atomic_load_n(&cache->local_hits, __ATOMIC_RELAXED),
+                           __atomic_load_n(&cache->remote_hits, __ATOMIC_RELAXED));
+#else
+    (void)cache;
+    int written = snprintf(buffer, size, "cache numa_hits=disabled (PROXY_CPU_PINNING 0)\n");
+#endif
+
+    if (written < 0) return 0;
+    return (size_t)written < size ? (size_t)written : size - 1;
+}
@@ -1,6 +1,8 @@
 #ifndef CACHE_H
 #define CACHE_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,31 +10,67 @@
 #include <time.h>
 
 #include "request.h"
+#include "cache_key.h"
+#include "affinity.h"
 
 #define MAX_CACHE_SIZE 3
 #define MAX_URL_LEN 1024
 #define CACHE_BUFFER_SIZE (500 * 1024 * 1024)  
+#define CACHE_LINE_SIZE 64
 
+// Время жизни закешированных ошибок (0 - не кешировать)
+#define NEGATIVE_TTL_NOT_FOUND_SEC 30
+#define NEGATIVE_TTL_SERVER_ERROR_SEC 5
+#define NEGATIVE_TTL_RESOLVE_SEC 10
+
+// Всё, что читается при поиске, лежит в первой кеш-линии элемента,
+// а сам ключ (канонический URL) хранится отдельно. key_hash, url и LRU
+// меняются только под cache_global_mutex (url - ещё и под elem_mutex),
+// так что поиск обходится без блокировок элементов
 typedef struct {
-    char url[MAX_URL_LEN];
+    uint64_t key_hash;
+    char* url;
     Data* data;
     time_t LRU;
+    time_t expires;
+    int status_code;
     int is_loading;
     int is_size_full;
     int is_error;
+    int numa_node;  // узел, на котором поток загрузки заполнил data
+    int refs;       // сколько потоков держат элемент, см. release_item
     pthread_mutex_t elem_mutex;
     pthread_cond_t loading_cond;
-} CacheItem;
+} __attribute__((aligned(CACHE_LINE_SIZE))) CacheItem;
+
+_Static_assert(offsetof(CacheItem, refs) + sizeof(int) <= CACHE_LINE_SIZE,
+               "CacheItem hot metadata must fit in one cache line");
 
 typedef struct {
     CacheItem cache[MAX_CACHE_SIZE];
     pthread_mutex_t cache_global_mutex;
+
+    // Попадания, обслуженные с памяти своего / чужого NUMA-узла
+    unsigned long local_hits;
+    unsigned long remote_hits;
 } Cache;
 
 void init_cache(Cache* cache);
 void destroy_cache(Cache* cache);
 
-void delete_item(const char* url, Cache* cache);
+// url - канонический ключ из build_cache_key. atomic_find_or_add_url
+// возвращает элемент, закреплённый за вызывающим: его не вытеснят и не
+// отдадут другому ключу до release_item. NULL - если вытеснить некого.
+// delete_item возвращает -1, если элемент сейчас закреплён или загружается
+int delete_item(const char* url, Cache* cache);
 CacheItem* atomic_find_or_add_url(Cache* cache, const char* url);
+void release_item(CacheItem* item);
+
+// Счётчики попаданий по NUMA ведутся только при PROXY_CPU_PINNING 1
+void count_numa_hit(Cache* cache, CacheItem* item);
+size_t cache_stats(Cache* cache, char* buffer, size_t size);
+
+int negative_ttl(int status_code);
+int drop_expired_data(CacheItem* item);
 
 #endif //CACHE_H
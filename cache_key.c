@@ -0,0 +1,271 @@
+#include "cache_key.h"
+
+#include <ctype.h>
+#include <strings.h>
+
+#define HASH_PRIME_1 0x9E3779B185EBCA87ULL
+#define HASH_PRIME_2 0xC2B2AE3D27D4EB4FULL
+#define HASH_PRIME_3 0x165667B19E3779F9ULL
+
+// Параметры, которые не влияют на ответ и не должны плодить копии в кеше
+static const char* cache_key_ignored_params[] = {
+    "utm_", "fbclid=", "gclid=", NULL
+};
+
+typedef struct {
+    const char* start;
+    size_t len;
+} QueryParam;
+
+static int compare_params(const void* a, const void* b) {
+    const QueryParam* left = (const QueryParam*)a;
+    const QueryParam* right = (const QueryParam*)b;
+
+    size_t len = left->len < right->len ? left->len : right->len;
+    int cmp = memcmp(left->start, right->start, len);
+    if (cmp != 0) return cmp;
+    return (left->len > right->len) - (left->len < right->len);
+}
+
+static int is_ignored_param(const char* param, size_t len) {
+    if (!CACHE_KEY_FILTER_QUERY) return 0;
+
+    for (int i = 0; cache_key_ignored_params[i] != NULL; ++i) {
+        size_t prefix_len = strlen(cache_key_ignored_params[i]);
+        if (len >= prefix_len && strncmp(param, cache_key_ignored_params[i], prefix_len) == 0) return 1;
+    }
+    return 0;
+}
+
+// Символы, допустимые в схеме и в host[:port]. Всё остальное (/, ?, #, @,
+// пробелы, управляющие символы) сделало бы ключ неоднозначным
+static int is_valid_scheme(const char* scheme, size_t len) {
+    if (len == 0) return 0;
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char c = (unsigned char)scheme[i];
+        if (!isalnum(c) && c != '+' && c != '-' && c != '.') return 0;
+    }
+    return 1;
+}
+
+static int is_valid_authority(const char* authority, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char c = (unsigned char)authority[i];
+        if (c <= ' ' || c >= 0x7f || strchr("/?#@\\\"", c) != NULL) return 0;
+    }
+    return 1;
+}
+
+static int is_valid_port(const char* port, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        if (!isdigit((unsigned char)port[i])) return 0;
+    }
+    return 1;
+}
+
+static const char* default_port(const char* scheme, size_t scheme_len) {
+    if (scheme_len == 4 && strncasecmp(scheme, "http", 4) == 0) return "80";
+    if (scheme_len == 5 && strncasecmp(scheme, "https", 5) == 0) return "443";
+    return NULL;
+}
+
+// Дописывает параметры запроса в key, возвращает новую длину
+static size_t append_query(char* key, size_t key_len, const char* query, size_t query_len) {
+    QueryParam params[CACHE_KEY_MAX_PARAMS];
+    int count = 0;
+    int overflow = 0;
+
+    const char* pos = query;
+    const char* end = query + query_len;
+    while (pos < end) {
+        const char* param_end = memchr(pos, '&', end - pos);
+        if (param_end == NULL) param_end = end;
+
+        size_t len = param_end - pos;
+        if (len > 0 && !is_ignored_param(pos, len)) {
+            if (count == CACHE_KEY_MAX_PARAMS) {
+                overflow = 1;
+                break;
+            }
+            params[count].start = pos;
+            params[count].len = len;
+            count++;
+        }
+        pos = param_end + 1;
+    }
+
+    // Слишком много параметров - оставляем запрос как есть
+    if (overflow) {
+        key[key_len++] = '?';
+        memcpy(key + key_len, query, query_len);
+        return key_len + query_len;
+    }
+
+    if (count == 0) return key_len;
+
+    if (CACHE_KEY_SORT_QUERY) {
+        qsort(params, count, sizeof(QueryParam), compare_params);
+    }
+
+    key[key_len++] = '?';
+    for (int i = 0; i < count; ++i) {
+        if (i > 0) key[key_len++] = '&';
+        memcpy(key + key_len, params[i].start, params[i].len);
+        key_len += params[i].len;
+    }
+    return key_len;
+}
+
+char* build_cache_key(const char* target, const char* host) {
+    const char* scheme = "http";
+    size_t scheme_len = 4;
+    const char* authority;
+    size_t authority_len;
+    const char* path;
+
+    const char* scheme_end = strstr(target, "://");
+    if (target[0] == '/') {
+        // origin-form: GET /path HTTP/1.1 + Host
+        if (host == NULL || host[0] == '\0') return NULL;
+        authority = host;
+        authority_len = strlen(host);
+        path = target;
+    } else if (scheme_end != NULL) {
+        // absolute-form: GET http://host/path HTTP/1.1
+        scheme = target;
+        scheme_len = scheme_end - target;
+        authority = scheme_end + 3;
+        authority_len = strcspn(authority, "/?#");
+        path = authority + authority_len;
+    } else {
+        return NULL;
+    }
+
+    if (!is_valid_scheme(scheme, scheme_len) || !is_valid_authority(authority, authority_len)) return NULL;
+
+    // Отделяем порт: host, [IPv6] или host:port / [IPv6]:port
+    size_t host_len = authority_len;
+    const char* port = NULL;
+    size_t port_len = 0;
+    const char* port_sep;
+    if (authority_len > 0 && authority[0] == '[') {
+        const char* bracket = memchr(authority, ']', authority_len);
+        if (bracket == NULL || memchr(authority + 1, '[', bracket - authority - 1) != NULL) return NULL;
+        host_len = bracket - authority + 1;
+        port_sep = host_len < authority_len ? authority + host_len : NULL;
+        if (port_sep != NULL && *port_sep != ':') return NULL;
+    } else {
+        port_sep = memchr(authority, ':', authority_len);
+        if (port_sep != NULL) host_len = port_sep - authority;
+        if (memchr(authority, '[', host_len) != NULL || memchr(authority, ']', host_len) != NULL) return NULL;
+    }
+    if (port_sep != NULL) {
+        port = port_sep + 1;
+        port_len = authority + authority_len - port;
+    }
+    if (host_len == 0 || (port != NULL && !is_valid_port(port, port_len))) return NULL;
+
+    const char* known_port = default_port(scheme, scheme_len);
+    if (port != NULL && (port_len == 0 ||
+        (known_port != NULL && port_len == strlen(known_port) && strncmp(port, known_port, port_len) == 0))) {
+        port = NULL;
+        port_len = 0;
+    }
+
+    size_t path_len = strcspn(path, "?#");
+    const char* query = NULL;
+    size_t query_len = 0;
+    if (path[path_len] == '?') {
+        query = path + path_len + 1;
+        query_len = strcspn(query, "#");
+    }
+
+    char* key = (char*)malloc(scheme_len + 3 + host_len + 1 + port_len + 1 + path_len + 1 + query_len + 1);
+    size_t key_len = 0;
+
+    for (size_t i = 0; i < scheme_len; ++i) key[key_len++] = (char)tolower((unsigned char)scheme[i]);
+    memcpy(key + key_len, "://", 3);
+    key_len += 3;
+
+    for (size_t i = 0; i < host_len; ++i) key[key_len++] = (char)tolower((unsigned char)authority[i]);
+    if (port != NULL) {
+        key[key_len++] = ':';
+        memcpy(key + key_len, port, port_len);
+        key_len += port_len;
+    }
+
+    if (path_len == 0) {
+        key[key_len++] = '/';
+    } else {
+        memcpy(key + key_len, path, path_len);
+        key_len += path_len;
+    }
+
+    if (query != NULL) {
+        key_len = append_query(key, key_len, query, query_len);
+    }
+
+    key[key_len] = '\0';
+    return key;
+}
+
+int cache_key_matches_host(const char* key, const char* host) {
+    if (host == NULL) return 0;
+
+    const char* authority = strstr(key, "://");
+    if (authority == NULL) return 0;
+    authority += 3;
+
+    size_t prefix_len = authority - key;
+    size_t authority_len = strcspn(authority, "/");
+    size_t host_len = strlen(host);
+    if (strcspn(host, "/?#") != host_len) return 0;
+
+    // Канонизируем Host так же, как ключ: с той же схемой и пустым путём
+    char* target = (char*)malloc(prefix_len + host_len + 2);
+    memcpy(target, key, prefix_len);
+    memcpy(target + prefix_len, host, host_len);
+    target[prefix_len + host_len] = '/';
+    target[prefix_len + host_len + 1] = '\0';
+
+    char* host_key = build_cache_key(target, NULL);
+    free(target);
+
+    int matches = host_key != NULL &&
+                  strncmp(host_key, key, prefix_len + authority_len) == 0 &&
+                  host_key[prefix_len + authority_len] == '/';
+    free(host_key);
+    return matches;
+}
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// 64-битный хеш, читающий ключ по 8 байт, с финализатором из MurmurHash3
+uint64_t hash_cache_key(const char* key, size_t len) {
+    uint64_t hash = HASH_PRIME_3 + len * HASH_PRIME_1;
+
+    while (len >= 8) {
+        uint64_t block;
+        memcpy(&block, key, 8);
+        hash ^= rotl64(block * HASH_PRIME_2, 31) * HASH_PRIME_1;
+        hash = rotl64(hash, 27) * HASH_PRIME_1 + HASH_PRIME_3;
+        key += 8;
+        len -= 8;
+    }
+
+    if (len > 0) {
+        uint64_t tail = 0;
+        memcpy(&tail, key, len);
+        hash ^= rotl64(tail * HASH_PRIME_2, 31) * HASH_PRIME_1;
+        hash = rotl64(hash, 27) * HASH_PRIME_1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
@@ -0,0 +1,24 @@
+#ifndef CACHE_KEY_H
+#define CACHE_KEY_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Сортировать параметры запроса, чтобы ?a=1&b=2 и ?b=2&a=1 совпадали
+#define CACHE_KEY_SORT_QUERY 1
+// Отбрасывать параметры из cache_key_ignored_params (utm_* и т.п.)
+#define CACHE_KEY_FILTER_QUERY 1
+#define CACHE_KEY_MAX_PARAMS 64
+
+// Канонический ключ: scheme://host[:port]/path[?query] с хостом в нижнем
+// регистре и без порта по умолчанию. target - absolute-form или origin-form,
+// во втором случае хост берётся из заголовка Host. NULL, если ключ не построить
+char* build_cache_key(const char* target, const char* host);
+// 1, если Host после канонизации совпадает с host[:port] ключа. Загрузка
+// идёт на сервер из Host, поэтому absolute-form с другим хостом отравил бы ключ
+int cache_key_matches_host(const char* key, const char* host);
+
+uint64_t hash_cache_key(const char* key, size_t len);
+
+#endif //CACHE_KEY_H
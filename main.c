@@ -1,43 +1,57 @@
 #include <signal.h>
+#include <stdint.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
 #include "proxy.h"
 
-int server_socket;
+int* server_sockets;
+int* listener_cpus;
+int listeners_count = 1;
 int server_is_on = 1;
 Cache* cache;
+OriginTable* origins;
+PrefetchQueue* prefetch;
+
+void close_listeners() {
+    for (int i = 0; i < listeners_count; ++i) {
+        close(server_sockets[i]);
+    }
+}
 
 void signal_handler(int signum) {
     if (signum == SIGINT) {
         printf("Received SIGINT, closing socket...\n");
-        close(server_socket);
+        close_listeners();
         server_is_on = 0;
 
+        destroy_prefetch(prefetch);
         destroy_cache(cache);
+        destroy_origins(origins);
         exit(signum);
     }
 }
 
 // *.local;*.ru:443;*.com:443;https://*
 
-int main() {
-    signal(SIGINT, signal_handler);
+// Принимает соединения на одном слушающем сокете. Потоки обработки
+// наследуют привязку к ядру от потока accept
+void* accept_loop(void* arg) {
+    int listener = (int)(intptr_t)arg;
+    int server_socket = server_sockets[listener];
 
-    struct sockaddr_in server_addr, client_addr;
+    struct sockaddr_in client_addr;
     socklen_t client_addr_len = sizeof(client_addr);
 
-    server_socket = server_socket_init();
-    set_params(&server_addr);
-    binding_and_listening(server_socket, &server_addr);
-
-    cache = (Cache*)malloc(sizeof(Cache));
-    init_cache(cache);
+    if (PROXY_CPU_PINNING) {
+        pin_current_thread(listener_cpus[listener]);
+    }
 
     while (server_is_on) {
         printf("Waiting for connection...\n");
 
         // Ожидаем клиентов
+        client_addr_len = sizeof(client_addr);
         int client_socket = accept(server_socket, (struct sockaddr*)&client_addr, &client_addr_len);
         if (client_socket < 0) {
             perror("Error accepting connection");
@@ -48,21 +62,78 @@ int main() {
         struct FuncArgs* args = malloc(sizeof(struct FuncArgs));
         args->client_socket = client_socket;
         args->cache = cache;
+        args->origins = origins;
+        args->prefetch = prefetch;
 
         // Запускаем поток для обработки соединения
         pthread_t tid;
         int err = pthread_create(&tid, NULL, (void* (*)(void *))handle_client_request, args);
         if (err) {
             perror("Error creating thread");
-            close(server_socket);
+            close_listeners();
+            destroy_prefetch(prefetch);
             destroy_cache(cache);
+            destroy_origins(origins);
             exit(-1);
         }
         pthread_detach(tid); // Отрываем поток, чтобы он завершился сам
     }
 
-    close(server_socket);
+    return NULL;
+}
+
+// Необязательный аргумент - файл со списком URL или access log для прогрева кеша
+int main(int argc, char* argv[]) {
+    signal(SIGINT, signal_handler);
+    // Запись в закрытый клиентом сокет должна вернуть EPIPE, а не убить процесс
+    signal(SIGPIPE, SIG_IGN);
+
+    struct sockaddr_in server_addr;
+
+    if (PROXY_CPU_PINNING) {
+        listener_cpus = affinity_cpus(&listeners_count);
+    } else {
+        listener_cpus = (int*)calloc(1, sizeof(int));
+    }
+    server_sockets = (int*)calloc(listeners_count, sizeof(int));
+
+    set_params(&server_addr);
+    for (int i = 0; i < listeners_count; ++i) {
+        server_sockets[i] = server_socket_init(PROXY_CPU_PINNING ? listener_cpus[i] : -1);
+        binding_and_listening(server_sockets[i], &server_addr);
+    }
+
+    cache = (Cache*)aligned_alloc(CACHE_LINE_SIZE, sizeof(Cache));
+    init_cache(cache);
+
+    origins = (OriginTable*)malloc(sizeof(OriginTable));
+    init_origins(origins);
+
+    prefetch = (PrefetchQueue*)malloc(sizeof(PrefetchQueue));
+    init_prefetch(prefetch, cache, origins);
+
+    if (argc > 1) {
+        prefetch_submit_file(prefetch, argv[1]);
+    }
+
+    // Нулевой сокет обслуживает главный поток, остальные - отдельные потоки
+    for (int i = 1; i < listeners_count; ++i) {
+        pthread_t tid;
+        int err = pthread_create(&tid, NULL, &accept_loop, (void*)(intptr_t)i);
+        if (err) {
+            fprintf(stderr, "Error creating accept thread: %s\n", strerror(err));
+            continue;
+        }
+        pthread_detach(tid);
+    }
+    accept_loop((void*)(intptr_t)0);
+
+    close_listeners();
+    destroy_prefetch(prefetch);
     destroy_cache(cache);
+    destroy_origins(origins);
+    free(server_sockets);
+    free(listener_cpus);
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,180 @@
+#include "origin.h"
+
+#include <strings.h>
+
+void init_origins(OriginTable* table) {
+    memset(table->origins, 0, sizeof(table->origins));
+    pthread_mutex_init(&table->origins_mutex, NULL);
+    pthread_cond_init(&table->slot_cond, NULL);
+}
+
+void destroy_origins(OriginTable* table) {
+    if (table == NULL) return;
+
+    pthread_mutex_destroy(&table->origins_mutex);
+    pthread_cond_destroy(&table->slot_cond);
+    free(table);
+}
+
+// Вызывается под origins_mutex
+static OriginState* find_origin(OriginTable* table, const char* host) {
+    for (int i = 0; i < MAX_ORIGINS; ++i) {
+        if (table->origins[i].host[0] != '\0' &&
+            strcasecmp(table->origins[i].host, host) == 0) {
+            return &table->origins[i];
+        }
+    }
+    return NULL;
+}
+
+// Вызывается под origins_mutex. Занимает свободный слот или вытесняет
+// самый старый простаивающий сервер: в первую очередь с закрытым или
+// истёкшим предохранителем, а если таких нет - с открытым. Иначе клиент,
+// открыв предохранители на MAX_ORIGINS адресах, закрыл бы прокси для всех.
+static OriginState* find_or_add_origin(OriginTable* table, const char* host) {
+    OriginState* origin = find_origin(table, host);
+    if (origin != NULL) return origin;
+
+    OriginState* open_origin = NULL;
+    time_t now = time(NULL);
+
+    for (int i = 0; i < MAX_ORIGINS; ++i) {
+        OriginState* candidate = &table->origins[i];
+
+        if (candidate->host[0] == '\0') {
+            origin = candidate;
+            break;
+        }
+        if (candidate->in_flight > 0 || candidate->is_probing) {
+            continue;
+        }
+        if (candidate->circuit_open_until > now) {
+            if (open_origin == NULL || candidate->last_used < open_origin->last_used) {
+                open_origin = candidate;
+            }
+            continue;
+        }
+        if (origin == NULL || candidate->last_used < origin->last_used) {
+            origin = candidate;
+        }
+    }
+
+    if (origin == NULL) origin = open_origin;
+    if (origin == NULL) return NULL;
+
+    memset(origin, 0, sizeof(*origin));
+    strncpy(origin->host, host, MAX_HOST_LEN - 1);
+    return origin;
+}
+
+OriginAdmission origin_acquire(OriginTable* table, const char* host) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += ORIGIN_ADMISSION_WAIT_SEC;
+
+    pthread_mutex_lock(&table->origins_mutex);
+
+    OriginState* origin = find_or_add_origin(table, host);
+    if (origin == NULL) {
+        pthread_mutex_unlock(&table->origins_mutex);
+        return ORIGIN_BUSY;
+    }
+
+    time_t now = time(NULL);
+    if (origin->circuit_open_until != 0) {
+        // Пока предохранитель открыт, запросы сразу отклоняются.
+        // После истечения пропускаем ровно один пробный запрос.
+        if (origin->circuit_open_until > now || origin->is_probing) {
+            origin->rejected++;
+            pthread_mutex_unlock(&table->origins_mutex);
+            return ORIGIN_CIRCUIT_OPEN;
+        }
+        origin->is_probing = 1;
+    }
+
+    while (origin->in_flight >= ORIGIN_MAX_IN_FLIGHT) {
+        int err = pthread_cond_timedwait(&table->slot_cond, &table->origins_mutex, &deadline);
+
+        // Пока ждали, запись могла быть вытеснена
+        origin = find_or_add_origin(table, host);
+        if (origin == NULL) {
+            pthread_mutex_unlock(&table->origins_mutex);
+            return ORIGIN_BUSY;
+        }
+
+        if (err != 0 && origin->in_flight >= ORIGIN_MAX_IN_FLIGHT) {
+            origin->rejected++;
+            pthread_mutex_unlock(&table->origins_mutex);
+            return ORIGIN_BUSY;
+        }
+    }
+
+    origin->in_flight++;
+    origin->fetches++;
+    origin->last_used = now;
+
+    pthread_mutex_unlock(&table->origins_mutex);
+    return ORIGIN_ADMITTED;
+}
+
+void origin_release(OriginTable* table, const char* host, OriginResult result) {
+    pthread_mutex_lock(&table->origins_mutex);
+
+    OriginState* origin = find_origin(table, host);
+    if (origin == NULL) {
+        pthread_mutex_unlock(&table->origins_mutex);
+        return;
+    }
+
+    if (origin->in_flight > 0) origin->in_flight--;
+    origin->last_used = time(NULL);
+
+    if (result == ORIGIN_RESULT_OK) {
+        origin->consecutive_failures = 0;
+        origin->circuit_open_until = 0;
+        origin->is_probing = 0;
+    } else {
+        origin->failures++;
+        if (result == ORIGIN_RESULT_TIMEOUT) origin->timeouts++;
+        origin->consecutive_failures++;
+
+        if (origin->is_probing || origin->consecutive_failures >= ORIGIN_FAILURE_THRESHOLD) {
+            printf("Opening circuit for %s for %d seconds\n", origin->host, ORIGIN_CIRCUIT_OPEN_SEC);
+            origin->circuit_open_until = origin->last_used + ORIGIN_CIRCUIT_OPEN_SEC;
+            origin->is_probing = 0;
+        }
+    }
+
+    pthread_cond_broadcast(&table->slot_cond);
+    pthread_mutex_unlock(&table->origins_mutex);
+}
+
+size_t origin_stats(OriginTable* table, char* buffer, size_t size) {
+    size_t len = 0;
+    time_t now = time(NULL);
+
+    pthread_mutex_lock(&table->origins_mutex);
+
+    for (int i = 0; i < MAX_ORIGINS && len < size; ++i) {
+        OriginState* origin = &table->origins[i];
+        if (origin->host[0] == '\0') continue;
+
+        const char* state = "closed";
+        if (origin->circuit_open_until > now) {
+            state = "open";
+        } else if (origin->circuit_open_until != 0) {
+            state = "half-open";
+        }
+
+        int written = snprintf(buffer + len, size - len,
+                               "%s in_flight=%d circuit=%s fetches=%lu failures=%lu timeouts=%lu rejected=%lu\n",
+                               origin->host, origin->in_flight, state,
+                               origin->fetches, origin->failures, origin->timeouts, origin->rejected);
+        if (written < 0) break;
+        len += (size_t)written;
+    }
+
+    pthread_mutex_unlock(&table->origins_mutex);
+
+    return len < size ? len : size - 1;
+}
@@ -0,0 +1,64 @@
+#ifndef ORIGIN_H
+#define ORIGIN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#define MAX_ORIGINS 64
+#define MAX_HOST_LEN 50
+
+// Лимиты и таймауты для каждого удалённого сервера
+#define ORIGIN_MAX_IN_FLIGHT 4
+#define ORIGIN_ADMISSION_WAIT_SEC 5
+#define ORIGIN_FAILURE_THRESHOLD 5
+#define ORIGIN_CIRCUIT_OPEN_SEC 30
+
+#define CONNECT_TIMEOUT_SEC 5
+#define FIRST_BYTE_TIMEOUT_SEC 10
+#define IDLE_TIMEOUT_SEC 10
+#define TOTAL_TIMEOUT_SEC 120
+#define CLIENT_SEND_TIMEOUT_SEC 10
+
+typedef enum {
+    ORIGIN_ADMITTED,
+    ORIGIN_BUSY,
+    ORIGIN_CIRCUIT_OPEN
+} OriginAdmission;
+
+typedef enum {
+    ORIGIN_RESULT_OK,
+    ORIGIN_RESULT_FAILURE,
+    ORIGIN_RESULT_TIMEOUT
+} OriginResult;
+
+typedef struct {
+    char host[MAX_HOST_LEN];
+    int in_flight;
+    int consecutive_failures;
+    int is_probing;
+    time_t circuit_open_until;
+    time_t last_used;
+
+    unsigned long fetches;
+    unsigned long failures;
+    unsigned long timeouts;
+    unsigned long rejected;
+} OriginState;
+
+typedef struct {
+    OriginState origins[MAX_ORIGINS];
+    pthread_mutex_t origins_mutex;
+    pthread_cond_t slot_cond;
+} OriginTable;
+
+void init_origins(OriginTable* table);
+void destroy_origins(OriginTable* table);
+
+OriginAdmission origin_acquire(OriginTable* table, const char* host);
+void origin_release(OriginTable* table, const char* host, OriginResult result);
+size_t origin_stats(OriginTable* table, char* buffer, size_t size);
+
+#endif //ORIGIN_H
@@ -0,0 +1,436 @@
+#include "prefetch.h"
+#include "proxy.h"
+
+#include <strings.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+// Поиск подстроки в буфере, который может не заканчиваться нулём
+static const char* find_bytes(const char* buffer, size_t len, const char* needle) {
+    size_t needle_len = strlen(needle);
+    for (size_t i = 0; i + needle_len <= len; ++i) {
+        if (strncasecmp(buffer + i, needle, needle_len) == 0) return buffer + i;
+    }
+    return NULL;
+}
+
+// Длина host[:port] в URL вида http://host[:port]/path, 0 если URL не подходит
+static size_t url_host_len(const char* url) {
+    if (strncmp(url, "http://", 7) != 0) return 0;
+
+    size_t host_len = strcspn(url + 7, "/");
+    if (host_len >= MAX_HOST_LEN) return 0;
+    return host_len;
+}
+
+static char* build_request(const char* url) {
+    size_t host_len = url_host_len(url);
+    if (host_len == 0) return NULL;
+
+    size_t size = strlen(url) + host_len + 64;
+    char* request = (char*)malloc(size);
+    snprintf(request, size, "GET %s HTTP/1.1\r\nHost: %.*s\r\nConnection: close\r\n\r\n",
+             url, (int)host_len, url + 7);
+    return request;
+}
+
+// Вызывается под elem_mutex. Собирает абсолютные и корневые ссылки из HTML-ответа
+static int collect_links(CacheItem* item, const char* page_url, char** links) {
+    const char* memory = item->data->memory;
+    size_t size = item->data->size;
+
+    const char* headers_end = find_bytes(memory, size, "\r\n\r\n");
+    if (headers_end == NULL) return 0;
+    if (find_bytes(memory, headers_end - memory, "Content-Type: text/html") == NULL) return 0;
+
+    size_t host_len = url_host_len(page_url);
+    int count = 0;
+    const char* pos = headers_end + 4;
+    const char* end = memory + size;
+
+    while (count < PREFETCH_MAX_LINKS_PER_PAGE) {
+        const char* href = find_bytes(pos, end - pos, "href=\"");
+        if (href == NULL) break;
+
+        const char* link_start = href + 6;
+        const char* link_end = memchr(link_start, '"', end - link_start);
+        if (link_end == NULL) break;
+        pos = link_end + 1;
+
+        size_t link_len = link_end - link_start;
+        char* link = NULL;
+
+        if (link_len > 7 && strncmp(link_start, "http://", 7) == 0 && link_len < MAX_URL_LEN) {
+            link = strndup(link_start, link_len);
+        } else if (link_len > 1 && link_start[0] == '/' && link_start[1] != '/' &&
+                   7 + host_len + link_len < MAX_URL_LEN) {
+            link = (char*)malloc(7 + host_len + link_len + 1);
+            sprintf(link, "%.*s%.*s", (int)(7 + host_len), page_url, (int)link_len, link_start);
+        }
+
+        if (link != NULL) links[count++] = link;
+    }
+
+    return count;
+}
+
+// Возвращает 1, если URL действительно загружался с сервера
+static int prefetch_one(PrefetchQueue* queue, PrefetchTask* task) {
+    char* request = build_request(task->url);
+    if (request == NULL) {
+        printf("Prefetch: skipping unsupported URL %s\n", task->url);
+        pthread_mutex_lock(&queue->queue_mutex);
+        queue->skipped++;
+        pthread_mutex_unlock(&queue->queue_mutex);
+        return 0;
+    }
+
+    char* key = build_cache_key(task->url, NULL);
+    if (key == NULL) {
+        pthread_mutex_lock(&queue->queue_mutex);
+        queue->skipped++;
+        pthread_mutex_unlock(&queue->queue_mutex);
+        free(request);
+        return 0;
+    }
+
+    CacheItem* item = atomic_find_or_add_url(queue->cache, key);
+    if (item == NULL) {
+        pthread_mutex_lock(&queue->queue_mutex);
+        queue->skipped++;
+        pthread_mutex_unlock(&queue->queue_mutex);
+        free(request);
+        free(key);
+        return 0;
+    }
+
+    pthread_mutex_lock(&item->elem_mutex);
+    drop_expired_data(item);
+    if (item->is_loading || (item->data->memory != NULL && item->data->size > 0)) {
+        pthread_mutex_unlock(&item->elem_mutex);
+        release_item(item);
+
+        pthread_mutex_lock(&queue->queue_mutex);
+        queue->skipped++;
+        pthread_mutex_unlock(&queue->queue_mutex);
+        free(request);
+        free(key);
+        return 0;
+    }
+    item->is_loading = 1;
+    pthread_mutex_unlock(&item->elem_mutex);
+
+    printf("Prefetch: fetching %s\n", task->url);
+
+    // Загружаем через тот же конвейер, что и клиентские промахи
+    ThreadArgs* args = (ThreadArgs*)malloc(sizeof(ThreadArgs));
+    args->cache = queue->cache;
+    args->origins = queue->origins;
+    args->request = request;
+    args->client_socket = -1;
+    args->item = item;
+    fetch_and_cache_data(args);
+
+    pthread_mutex_lock(&queue->queue_mutex);
+    queue->fetched++;
+    pthread_mutex_unlock(&queue->queue_mutex);
+
+    if (!PREFETCH_LINKS || task->depth > 0) {
+        release_item(item);
+        free(key);
+        return 1;
+    }
+
+    char* links[PREFETCH_MAX_LINKS_PER_PAGE];
+    int links_count = 0;
+
+    pthread_mutex_lock(&item->elem_mutex);
+    if (item->status_code == 200 && item->data->memory != NULL &&
+        item->url != NULL && strcmp(item->url, key) == 0) {
+        links_count = collect_links(item, task->url, links);
+    }
+    pthread_mutex_unlock(&item->elem_mutex);
+    release_item(item);
+    free(key);
+
+    for (int i = 0; i < links_count; ++i) {
+        prefetch_submit(queue, links[i], task->depth + 1);
+        free(links[i]);
+    }
+    return 1;
+}
+
+static void* prefetch_worker(void* arg) {
+    PrefetchQueue* queue = (PrefetchQueue*)arg;
+
+    // Фоновая загрузка не должна отнимать процессор у клиентских потоков
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), PREFETCH_NICE);
+
+    while (1) {
+        pthread_mutex_lock(&queue->queue_mutex);
+        while (queue->count == 0 && queue->is_running) {
+            pthread_cond_wait(&queue->queue_cond, &queue->queue_mutex);
+        }
+        if (!queue->is_running) {
+            pthread_mutex_unlock(&queue->queue_mutex);
+            break;
+        }
+
+        PrefetchTask task = queue->tasks[queue->head];
+        queue->head = (queue->head + 1) % PREFETCH_QUEUE_SIZE;
+        queue->count--;
+        pthread_cond_signal(&queue->space_cond);
+        pthread_mutex_unlock(&queue->queue_mutex);
+
+        // Ограничиваем только обращения к серверам: пропуск уже
+        // закешированного URL их не нагружает
+        int fetched = prefetch_one(queue, &task);
+        free(task.url);
+
+        if (fetched) usleep(1000000 / PREFETCH_RATE_PER_SEC);
+    }
+
+    return NULL;
+}
+
+void init_prefetch(PrefetchQueue* queue, Cache* cache, OriginTable* origins) {
+    memset(queue->tasks, 0, sizeof(queue->tasks));
+    queue->head = queue->count = 0;
+    queue->queued = queue->fetched = queue->skipped = queue->dropped = queue->duplicates = 0;
+    memset(queue->seen, 0, sizeof(queue->seen));
+    queue->seen_count = 0;
+    queue->feeders = 0;
+    queue->cache = cache;
+    queue->origins = origins;
+    queue->is_running = 1;
+
+    pthread_mutex_init(&queue->queue_mutex, NULL);
+    pthread_cond_init(&queue->queue_cond, NULL);
+    pthread_cond_init(&queue->space_cond, NULL);
+
+    int err = pthread_create(&queue->worker, NULL, &prefetch_worker, queue);
+    if (err != 0) {
+        fprintf(stderr, "Error creating prefetch thread: %s\n", strerror(err));
+        queue->is_running = 0;
+    }
+}
+
+void destroy_prefetch(PrefetchQueue* queue) {
+    if (queue == NULL) return;
+
+    pthread_mutex_lock(&queue->queue_mutex);
+    int was_running = queue->is_running;
+    queue->is_running = 0;
+    pthread_cond_broadcast(&queue->queue_cond);
+    pthread_cond_broadcast(&queue->space_cond);
+
+    // Потоки чтения увидят is_running = 0 и завершатся
+    while (queue->feeders > 0) {
+        pthread_cond_wait(&queue->space_cond, &queue->queue_mutex);
+    }
+    pthread_mutex_unlock(&queue->queue_mutex);
+
+    if (was_running) pthread_join(queue->worker, NULL);
+
+    for (int i = 0; i < queue->count; ++i) {
+        free(queue->tasks[(queue->head + i) % PREFETCH_QUEUE_SIZE].url);
+    }
+
+    pthread_mutex_destroy(&queue->queue_mutex);
+    pthread_cond_destroy(&queue->queue_cond);
+    pthread_cond_destroy(&queue->space_cond);
+    free(queue);
+}
+
+// Вызывается под queue_mutex. Запоминает хеш ключа, возвращает 0, если
+// такой URL уже ставили в очередь. Заполненная таблица очищается целиком
+static int remember_url(PrefetchQueue* queue, uint64_t key_hash) {
+    if (key_hash == 0) key_hash = 1;
+
+    if (queue->seen_count >= PREFETCH_SEEN_SIZE * 3 / 4) {
+        memset(queue->seen, 0, sizeof(queue->seen));
+        queue->seen_count = 0;
+    }
+
+    size_t index = key_hash % PREFETCH_SEEN_SIZE;
+    while (queue->seen[index] != 0) {
+        if (queue->seen[index] == key_hash) return 0;
+        index = (index + 1) % PREFETCH_SEEN_SIZE;
+    }
+    queue->seen[index] = key_hash;
+    queue->seen_count++;
+    return 1;
+}
+
+// wait - ждать места в очереди вместо того, чтобы отбросить URL
+static int enqueue(PrefetchQueue* queue, const char* url, int depth, int wait) {
+    char* key = build_cache_key(url, NULL);
+    int has_key = key != NULL;
+    uint64_t key_hash = has_key ? hash_cache_key(key, strlen(key)) : 0;
+    free(key);
+
+    pthread_mutex_lock(&queue->queue_mutex);
+
+    while (wait && queue->is_running && queue->count == PREFETCH_QUEUE_SIZE) {
+        pthread_cond_wait(&queue->space_cond, &queue->queue_mutex);
+    }
+
+    if (!queue->is_running || queue->count == PREFETCH_QUEUE_SIZE) {
+        queue->dropped++;
+        pthread_mutex_unlock(&queue->queue_mutex);
+        return -1;
+    }
+
+    if (has_key && !remember_url(queue, key_hash)) {
+        queue->duplicates++;
+        pthread_mutex_unlock(&queue->queue_mutex);
+        return -1;
+    }
+
+    PrefetchTask* task = &queue->tasks[(queue->head + queue->count) % PREFETCH_QUEUE_SIZE];
+    task->url = strdup(url);
+    task->depth = depth;
+    queue->count++;
+    queue->queued++;
+
+    pthread_cond_signal(&queue->queue_cond);
+    pthread_mutex_unlock(&queue->queue_mutex);
+    return 0;
+}
+
+int prefetch_submit(PrefetchQueue* queue, const char* url, int depth) {
+    return enqueue(queue, url, depth, 0);
+}
+
+// Из строки берётся первый токен вида http://...,
+// так что подходят и простые списки URL, и access log прокси
+static int submit_line(PrefetchQueue* queue, const char* line, const char* line_end) {
+    const char* url = find_bytes(line, line_end - line, "http://");
+    if (url == NULL) return 0;
+
+    size_t url_len = 0;
+    while (url + url_len < line_end && strchr(" \t\r\n\"", url[url_len]) == NULL) url_len++;
+    if (url_len >= MAX_URL_LEN) return 0;
+
+    char buffer[MAX_URL_LEN];
+    memcpy(buffer, url, url_len);
+    buffer[url_len] = '\0';
+    return enqueue(queue, buffer, 0, 1) == 0;
+}
+
+typedef struct {
+    PrefetchQueue* queue;
+    FILE* file;
+    char* text;  // буфер списка, из которого открыт file, или NULL
+    char* name;
+} PrefetchFeed;
+
+// Читает источник построчно и ждёт места в очереди, поэтому длинный
+// access log не блокирует запуск прокси и не теряется при переполнении
+static void* prefetch_feeder(void* arg) {
+    PrefetchFeed* feed = (PrefetchFeed*)arg;
+    PrefetchQueue* queue = feed->queue;
+
+    int queued = 0;
+    char* line = NULL;
+    size_t capacity = 0;
+    ssize_t len;
+
+    while ((len = getline(&line, &capacity, feed->file)) != -1) {
+        pthread_mutex_lock(&queue->queue_mutex);
+        int is_running = queue->is_running;
+        pthread_mutex_unlock(&queue->queue_mutex);
+        if (!is_running) break;
+
+        queued += submit_line(queue, line, line + len);
+    }
+
+    printf("Prefetch: queued %d URLs from %s\n", queued, feed->name);
+
+    free(line);
+    fclose(feed->file);
+    free(feed->text);
+    free(feed->name);
+    free(feed);
+
+    pthread_mutex_lock(&queue->queue_mutex);
+    queue->feeders--;
+    pthread_cond_broadcast(&queue->space_cond);
+    pthread_mutex_unlock(&queue->queue_mutex);
+    return NULL;
+}
+
+// Забирает file и text во владение потока чтения
+static int start_feeder(PrefetchQueue* queue, FILE* file, char* text, const char* name) {
+    PrefetchFeed* feed = (PrefetchFeed*)malloc(sizeof(PrefetchFeed));
+    feed->queue = queue;
+    feed->file = file;
+    feed->text = text;
+    feed->name = strdup(name);
+
+    pthread_mutex_lock(&queue->queue_mutex);
+    int is_running = queue->is_running;
+    if (is_running) queue->feeders++;
+    pthread_mutex_unlock(&queue->queue_mutex);
+
+    pthread_t tid;
+    int err = is_running ? pthread_create(&tid, NULL, &prefetch_feeder, feed) : -1;
+    if (err != 0) {
+        if (is_running) {
+            fprintf(stderr, "Error creating prefetch feeder thread: %s\n", strerror(err));
+            pthread_mutex_lock(&queue->queue_mutex);
+            queue->feeders--;
+            pthread_cond_broadcast(&queue->space_cond);
+            pthread_mutex_unlock(&queue->queue_mutex);
+        }
+        fclose(file);
+        free(text);
+        free(feed->name);
+        free(feed);
+        return -1;
+    }
+
+    pthread_detach(tid);
+    return 0;
+}
+
+int prefetch_submit_list(PrefetchQueue* queue, const char* text, size_t len) {
+    if (len == 0) return 0;
+
+    char* copy = (char*)malloc(len);
+    memcpy(copy, text, len);
+
+    FILE* file = fmemopen(copy, len, "r");
+    if (file == NULL) {
+        perror("Error opening prefetch list");
+        free(copy);
+        return -1;
+    }
+
+    return start_feeder(queue, file, copy, "request body");
+}
+
+// Access log может быть большим, поэтому читаем его построчно
+int prefetch_submit_file(PrefetchQueue* queue, const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        perror("Error opening prefetch list");
+        return -1;
+    }
+
+    return start_feeder(queue, file, NULL, path);
+}
+
+size_t prefetch_stats(PrefetchQueue* queue, char* buffer, size_t size) {
+    if (size == 0) return 0;
+
+    pthread_mutex_lock(&queue->queue_mutex);
+    int written = snprintf(buffer, size,
+                           "prefetch pending=%d queued=%lu fetched=%lu skipped=%lu dropped=%lu duplicates=%lu feeders=%d\n",
+                           queue->count, queue->queued, queue->fetched, queue->skipped, queue->dropped,
+                           queue->duplicates, queue->feeders);
+    pthread_mutex_unlock(&queue->queue_mutex);
+
+    if (written < 0) return 0;
+    return (size_t)written < size ? (size_t)written : size - 1;
+}
@@ -0,0 +1,64 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "cache.h"
+#include "origin.h"
+
+#define PREFETCH_QUEUE_SIZE 1024
+#define PREFETCH_RATE_PER_SEC 2
+#define PREFETCH_NICE 10
+#define PREFETCH_MAX_BODY (1024 * 1024)
+// Сколько разных URL помнить для отсева повторов (в access log их большинство)
+#define PREFETCH_SEEN_SIZE 8192
+
+// Подгружать ли ссылки из HTML-страниц (только на один уровень)
+#define PREFETCH_LINKS 1
+#define PREFETCH_MAX_LINKS_PER_PAGE 16
+
+typedef struct {
+    char* url;
+    int depth;
+} PrefetchTask;
+
+typedef struct {
+    PrefetchTask tasks[PREFETCH_QUEUE_SIZE];
+    int head;
+    int count;
+    int is_running;
+
+    unsigned long queued;
+    unsigned long fetched;
+    unsigned long skipped;
+    unsigned long dropped;
+    unsigned long duplicates;
+
+    // Хеши ключей уже поставленных в очередь URL, 0 - пустая ячейка
+    uint64_t seen[PREFETCH_SEEN_SIZE];
+    int seen_count;
+    int feeders;  // потоки, читающие файл или список в очередь
+
+    Cache* cache;
+    OriginTable* origins;
+    pthread_t worker;
+    pthread_mutex_t queue_mutex;
+    pthread_cond_t queue_cond;
+    pthread_cond_t space_cond;
+} PrefetchQueue;
+
+void init_prefetch(PrefetchQueue* queue, Cache* cache, OriginTable* origins);
+void destroy_prefetch(PrefetchQueue* queue);
+
+// prefetch_submit не ждёт места в очереди и отбрасывает URL при переполнении.
+// Список и файл читаются отдельным потоком, который ждёт освобождения места
+int prefetch_submit(PrefetchQueue* queue, const char* url, int depth);
+int prefetch_submit_list(PrefetchQueue* queue, const char* text, size_t len);
+int prefetch_submit_file(PrefetchQueue* queue, const char* path);
+size_t prefetch_stats(PrefetchQueue* queue, char* buffer, size_t size);
+
+#endif //PREFETCH_H
@@ -2,8 +2,11 @@
 
 #include <sys/types.h>
 #include <netdb.h>
+#include <sys/time.h>
 
-int server_socket_init() {
+// incoming_cpu >= 0: сокет - один из группы SO_REUSEPORT, и ядро отдаёт ему
+// соединения, пришедшие на этот CPU
+int server_socket_init(int incoming_cpu) {
     int server_socket = socket(AF_INET, SOCK_STREAM, 0); 
     if (server_socket < 0) {
         perror("Error creating socket");
@@ -11,6 +14,17 @@ int server_socket_init() {
     }
     int option = 1;
     setsockopt(server_socket, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option));
+
+    if (incoming_cpu >= 0) {
+        if (setsockopt(server_socket, SOL_SOCKET, SO_REUSEPORT, &option, sizeof(option)) < 0) {
+            perror("Error setting SO_REUSEPORT");
+        }
+#ifdef SO_INCOMING_CPU
+        if (setsockopt(server_socket, SOL_SOCKET, SO_INCOMING_CPU, &incoming_cpu, sizeof(incoming_cpu)) < 0) {
+            perror("Error setting SO_INCOMING_CPU");
+        }
+#endif
+    }
     return server_socket;
 }
 
@@ -43,7 +57,8 @@ int send_to(int socket, void* data, unsigned int size) {
     while (total_sent < size) {
         sent = write(socket, buffer + total_sent, size - total_sent);
         if (sent <= 0) {
-            if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // EAGAIN здесь означает истёкший SO_SNDTIMEO, повторять нельзя
+            if (sent < 0 && errno == EINTR) {
                 continue;
             }
             return -1;
@@ -54,14 +69,121 @@ int send_to(int socket, void* data, unsigned int size) {
     return total_sent;
 }
 
+// Служебные пути доступны только с локальной машины
+int is_admin_peer(int client_socket) {
+    struct sockaddr_in peer_addr;
+    socklen_t peer_addr_len = sizeof(peer_addr);
+
+    if (getpeername(client_socket, (struct sockaddr*)&peer_addr, &peer_addr_len) < 0) return 0;
+    if (peer_addr.sin_family != AF_INET) return 0;
+
+    // 127.0.0.0/8
+    return (ntohl(peer_addr.sin_addr.s_addr) >> 24) == 127;
+}
+
+void send_stats(int client_socket, Cache* cache, OriginTable* origins, PrefetchQueue* prefetch) {
+    char* body = calloc(STATS_BUFFER_SIZE, sizeof(char));
+    size_t body_len = cache_stats(cache, body, STATS_BUFFER_SIZE);
+    body_len += origin_stats(origins, body + body_len, STATS_BUFFER_SIZE - body_len);
+    body_len += prefetch_stats(prefetch, body + body_len, STATS_BUFFER_SIZE - body_len);
+
+    char header[256];
+    int header_len = snprintf(header, sizeof(header),
+                              "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+                              body_len);
+
+    send_to(client_socket, header, header_len);
+    send_to(client_socket, body, body_len);
+    free(body);
+}
+
+// Принимает список URL или access log и ставит их в очередь prefetch
+void handle_prefetch_request(int client_socket, char* request, size_t request_len, PrefetchQueue* prefetch) {
+    const char* response = NULL;
+    char reply[256];
+
+    const char* headers_end = strstr(request, "\r\n\r\n");
+    if (strncmp(request, "POST ", 5) != 0 || headers_end == NULL) {
+        response = "HTTP/1.1 405 Method Not Allowed\r\nAllow: POST\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        send_to(client_socket, (void*)response, strlen(response));
+        return;
+    }
+
+    size_t content_length = 0;
+    const char* length_header = strstr(request, "Content-Length: ");
+    if (length_header != NULL && length_header < headers_end) {
+        content_length = strtoul(length_header + 16, NULL, 10);
+    }
+    if (content_length > PREFETCH_MAX_BODY) {
+        response = "HTTP/1.1 413 Payload Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        send_to(client_socket, (void*)response, strlen(response));
+        return;
+    }
+
+    // Часть тела уже пришла вместе с заголовками, остальное дочитываем
+    char* body = (char*)calloc(content_length + 1, sizeof(char));
+    size_t body_read = request_len - (headers_end + 4 - request);
+    if (body_read > content_length) body_read = content_length;
+    memcpy(body, headers_end + 4, body_read);
+
+    while (body_read < content_length) {
+        ssize_t bytes_read = recv(client_socket, body + body_read, content_length - body_read, 0);
+        if (bytes_read <= 0) break;
+        body_read += bytes_read;
+    }
+
+    // Список ставится в очередь в фоне, ход прогрева виден в /__proxy/stats
+    int err = prefetch_submit_list(prefetch, body, body_read);
+    free(body);
+    if (err != 0) {
+        response = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        send_to(client_socket, (void*)response, strlen(response));
+        return;
+    }
+
+    char message[64];
+    int message_len = snprintf(message, sizeof(message), "accepted %zu bytes\n", body_read);
+    int reply_len = snprintf(reply, sizeof(reply),
+                             "HTTP/1.1 202 Accepted\r\nContent-Type: text/plain\r\nContent-Length: %d\r\nConnection: close\r\n\r\n%s",
+                             message_len, message);
+    send_to(client_socket, reply, reply_len);
+}
+
+static void send_service_unavailable(int client_socket) {
+    const char* response = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    send_to(client_socket, (void*)response, strlen(response));
+}
+
+static size_t build_resolve_error_response(char* buffer, size_t size, const char* host) {
+    char body[128];
+    int body_len = snprintf(body, sizeof(body), "Could not resolve host %s\n", host);
+
+    int len = snprintf(buffer, size,
+                       "HTTP/1.1 502 Bad Gateway\r\nContent-Type: text/plain\r\nContent-Length: %d\r\nConnection: close\r\n\r\n%s",
+                       body_len, body);
+    return len < 0 ? 0 : (size_t)len;
+}
+
+static long elapsed_ms(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
 void* fetch_and_cache_data(void* arg) {
     ThreadArgs* args = (ThreadArgs*)arg;
-    Cache* cache = args->cache;
+    OriginTable* origins = args->origins;
     char* request = args->request;
     int client_socket = args->client_socket;
     CacheItem* item = args->item;
+
+    // Результат прошлой неудачной загрузки не должен помешать этой
+    pthread_mutex_lock(&item->elem_mutex);
+    item->is_error = 0;
+    item->is_size_full = 0;
+    pthread_mutex_unlock(&item->elem_mutex);
     
-    char* host = extract_host(request, 50);
+    char* host = extract_host(request, MAX_HOST_LEN);
     char* url = extract_url(request);
     
     if (!host || !url) {
@@ -81,24 +203,61 @@ void* fetch_and_cache_data(void* arg) {
         return NULL;
     }
 
+    // Ограничиваем число параллельных загрузок с одного сервера
+    OriginAdmission admission = origin_acquire(origins, host);
+    if (admission != ORIGIN_ADMITTED) {
+        printf("Origin %s is %s, failing fast\n", host,
+               admission == ORIGIN_CIRCUIT_OPEN ? "unavailable" : "overloaded");
+        send_service_unavailable(client_socket);
+
+        pthread_mutex_lock(&item->elem_mutex);
+        item->is_error = 1;
+        item->is_loading = 0;
+        pthread_cond_broadcast(&item->loading_cond);
+        pthread_mutex_unlock(&item->elem_mutex);
+
+        free(host);
+        free(url);
+        free(request);
+        free(args);
+        close(client_socket);
+        return NULL;
+    }
+
+    struct timespec fetch_start;
+    clock_gettime(CLOCK_MONOTONIC, &fetch_start);
+
     // Инициализируем память для данных
     pthread_mutex_lock(&item->elem_mutex);
     item->data->memory = (char*)calloc(CACHE_BUFFER_SIZE, sizeof(char));
     item->data->size = 0;
+    item->expires = 0;
+    item->status_code = 0;
+    item->numa_node = current_numa_node();
     pthread_mutex_unlock(&item->elem_mutex);
 
     // Подключаемся к целевому серверу
-    int dest_socket = connect_to_remote(host);
-    if (dest_socket == -1) {
+    int dest_socket = connect_to_remote(host, CONNECT_TIMEOUT_SEC);
+    if (dest_socket < 0) {
         printf("Destiny socket error\n");
+        origin_release(origins, host, ORIGIN_RESULT_FAILURE);
         
         pthread_mutex_lock(&item->elem_mutex);
-        item->is_error = 1;
-        item->is_loading = 0;
-        if (item->data->memory != NULL) {
-            free(item->data->memory);
-            item->data->memory = NULL;
+        if (dest_socket == REMOTE_RESOLVE_ERROR && NEGATIVE_TTL_RESOLVE_SEC > 0 && item->data->memory != NULL) {
+            // Кешируем ответ 502, чтобы не резолвить несуществующий хост на каждый запрос
+            printf("Could not resolve %s, caching 502 for %d seconds\n", host, NEGATIVE_TTL_RESOLVE_SEC);
+            item->data->size = build_resolve_error_response(item->data->memory, CACHE_BUFFER_SIZE, host);
+            item->status_code = 502;
+            item->expires = time(NULL) + NEGATIVE_TTL_RESOLVE_SEC;
+            send_to(client_socket, item->data->memory, item->data->size);
+        } else {
+            item->is_error = 1;
+            if (item->data->memory != NULL) {
+                free(item->data->memory);
+                item->data->memory = NULL;
+            }
         }
+        item->is_loading = 0;
         pthread_cond_broadcast(&item->loading_cond);
         pthread_mutex_unlock(&item->elem_mutex);
         
@@ -116,6 +275,7 @@ void* fetch_and_cache_data(void* arg) {
     ssize_t bytes_sent = send_to(dest_socket, request, strlen(request));
     if (bytes_sent == -1) {
         printf("Error while sending request to remote server\n");
+        origin_release(origins, host, ORIGIN_RESULT_FAILURE);
         
         pthread_mutex_lock(&item->elem_mutex);
         item->is_error = 1;
@@ -138,30 +298,68 @@ void* fetch_and_cache_data(void* arg) {
     
     printf("Sent request to remote server, len = %zd\n", bytes_sent);
 
-    char buffer[BUFFER_SIZE] = {0};
-    ssize_t bytes_read, all_bytes_read = 0;
-    int client_disconnected = 0;
+    // +1 под завершающий ноль: статус ответа разбирается строковыми функциями
+    char buffer[BUFFER_SIZE + 1] = {0};
+    ssize_t bytes_read = 0, all_bytes_read = 0;
+    // У фоновой загрузки (prefetch) клиента нет
+    int client_disconnected = client_socket < 0;
     int first_chunk = 1;
+    OriginResult result = ORIGIN_RESULT_OK;
+
+    while (1) {
+        // До первого байта и между чанками ждём не дольше заданных таймаутов,
+        // а всю загрузку целиком - не дольше TOTAL_TIMEOUT_SEC
+        long remaining_ms = TOTAL_TIMEOUT_SEC * 1000L - elapsed_ms(&fetch_start);
+        long timeout_ms = (first_chunk ? FIRST_BYTE_TIMEOUT_SEC : IDLE_TIMEOUT_SEC) * 1000L;
+        if (remaining_ms < timeout_ms) timeout_ms = remaining_ms;
+
+        int ready = timeout_ms > 0 ? wait_readable(dest_socket, (int)timeout_ms) : 0;
+        if (ready == 0) {
+            printf("Timed out waiting for remote server %s\n", host);
+            result = ORIGIN_RESULT_TIMEOUT;
+            break;
+        }
+        if (ready < 0) {
+            result = ORIGIN_RESULT_FAILURE;
+            break;
+        }
+
+        bytes_read = read(dest_socket, buffer, BUFFER_SIZE);
+        if (bytes_read < 0) {
+            result = ORIGIN_RESULT_FAILURE;
+            break;
+        }
+        if (bytes_read == 0) break;
+        buffer[bytes_read] = '\0';
 
-    while ((bytes_read = read(dest_socket, buffer, BUFFER_SIZE)) > 0) {
         // Проверяем, не отключился ли клиент
         if (!client_disconnected) {
             // Пытаемся отправить данные клиенту
             ssize_t sent_to_client = send_to(client_socket, buffer, bytes_read);
             if (sent_to_client == -1) {
-                if (errno == EPIPE || errno == ECONNRESET) {
-                    printf("Client disconnected. Continuing to cache data...\n");
-                    client_disconnected = 1;
-                } else {
-                    printf("Error sending to client: %s\n", strerror(errno));
-                    break;
-                }
+                // Иначе в кеш попал бы обрезанный ответ
+                printf("Client disconnected (%s). Continuing to cache data...\n", strerror(errno));
+                client_disconnected = 1;
             }
         }
 
         // Проверяем статус ответа в первом чанке
         if (first_chunk) {
-            if (!is_response_status_ok(buffer)) {
+            int status_code = get_response_status(buffer);
+            int ttl = negative_ttl(status_code);
+
+            pthread_mutex_lock(&item->elem_mutex);
+            item->status_code = status_code;
+            pthread_mutex_unlock(&item->elem_mutex);
+
+            if (ttl > 0) {
+                // Ошибку кешируем вместе с телом, но ненадолго
+                printf("Server returned %d, caching it for %d seconds.\n", status_code, ttl);
+
+                pthread_mutex_lock(&item->elem_mutex);
+                item->expires = time(NULL) + ttl;
+                pthread_mutex_unlock(&item->elem_mutex);
+            } else if (!is_response_status_ok(buffer)) {
                 printf("Server returned error, not saving to cache.\n");
                 
                 pthread_mutex_lock(&item->elem_mutex);
@@ -201,9 +399,14 @@ void* fetch_and_cache_data(void* arg) {
         all_bytes_read += bytes_read;
     }
 
+    origin_release(origins, host, result);
+
     // Завершаем загрузку
     pthread_mutex_lock(&item->elem_mutex);
     item->is_loading = 0;
+    if (result != ORIGIN_RESULT_OK) {
+        item->is_error = 1;
+    }
     
     if (item->is_size_full || item->is_error) {
         printf("Error appeared while reading the response, freeing memory...\n");
@@ -220,7 +423,7 @@ void* fetch_and_cache_data(void* arg) {
     pthread_cond_broadcast(&item->loading_cond);
     pthread_mutex_unlock(&item->elem_mutex);
 
-    if (!client_disconnected) {
+    if (client_socket >= 0) {
         close(client_socket);
     }
     close(dest_socket);
@@ -232,17 +435,110 @@ void* fetch_and_cache_data(void* arg) {
     return NULL;
 }
 
+// Загрузка без кеширования: все слоты кеша заняты загрузками или
+// читателями, но клиенту всё равно нужен ответ, а не 503
+static void pass_through_request(int client_socket, OriginTable* origins, char* request) {
+    char* host = extract_host(request, MAX_HOST_LEN);
+    if (host == NULL) {
+        printf("Error: Could not extract host\n");
+        return;
+    }
+
+    OriginAdmission admission = origin_acquire(origins, host);
+    if (admission != ORIGIN_ADMITTED) {
+        printf("Origin %s is %s, failing fast\n", host,
+               admission == ORIGIN_CIRCUIT_OPEN ? "unavailable" : "overloaded");
+        send_service_unavailable(client_socket);
+        free(host);
+        return;
+    }
+
+    int dest_socket = connect_to_remote(host, CONNECT_TIMEOUT_SEC);
+    if (dest_socket < 0) {
+        printf("Destiny socket error\n");
+        origin_release(origins, host, ORIGIN_RESULT_FAILURE);
+        if (dest_socket == REMOTE_RESOLVE_ERROR) {
+            char response[256];
+            size_t response_len = build_resolve_error_response(response, sizeof(response), host);
+            send_to(client_socket, response, response_len);
+        } else {
+            send_service_unavailable(client_socket);
+        }
+        free(host);
+        return;
+    }
+
+    if (send_to(dest_socket, request, strlen(request)) == -1) {
+        printf("Error while sending request to remote server\n");
+        origin_release(origins, host, ORIGIN_RESULT_FAILURE);
+        send_service_unavailable(client_socket);
+        close(dest_socket);
+        free(host);
+        return;
+    }
+
+    struct timespec fetch_start;
+    clock_gettime(CLOCK_MONOTONIC, &fetch_start);
+
+    char buffer[BUFFER_SIZE];
+    int first_chunk = 1;
+    OriginResult result = ORIGIN_RESULT_OK;
+
+    while (1) {
+        long remaining_ms = TOTAL_TIMEOUT_SEC * 1000L - elapsed_ms(&fetch_start);
+        long timeout_ms = (first_chunk ? FIRST_BYTE_TIMEOUT_SEC : IDLE_TIMEOUT_SEC) * 1000L;
+        if (remaining_ms < timeout_ms) timeout_ms = remaining_ms;
+
+        int ready = timeout_ms > 0 ? wait_readable(dest_socket, (int)timeout_ms) : 0;
+        if (ready == 0) {
+            printf("Timed out waiting for remote server %s\n", host);
+            result = ORIGIN_RESULT_TIMEOUT;
+            break;
+        }
+        if (ready < 0) {
+            result = ORIGIN_RESULT_FAILURE;
+            break;
+        }
+
+        ssize_t bytes_read = read(dest_socket, buffer, BUFFER_SIZE);
+        if (bytes_read < 0) {
+            result = ORIGIN_RESULT_FAILURE;
+            break;
+        }
+        if (bytes_read == 0) break;
+        first_chunk = 0;
+
+        if (send_to(client_socket, buffer, bytes_read) == -1) {
+            printf("Client disconnected (%s)\n", strerror(errno));
+            break;
+        }
+    }
+
+    origin_release(origins, host, result);
+    close(dest_socket);
+    free(host);
+}
+
 void handle_client_request(void* args) {
     struct FuncArgs* arg = (struct FuncArgs*)args;
     int client_socket = arg->client_socket;
     Cache* cache = arg->cache;
+    OriginTable* origins = arg->origins;
+    PrefetchQueue* prefetch = arg->prefetch;
     
     free(args);
 
     printf("Handling client request...\n");
+
+    // Клиент, переставший читать, не должен держать поток загрузки
+    // (и слот in_flight сервера) дольше CLIENT_SEND_TIMEOUT_SEC
+    struct timeval send_timeout = { .tv_sec = CLIENT_SEND_TIMEOUT_SEC, .tv_usec = 0 };
+    setsockopt(client_socket, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+
     char* buffer = calloc(BUFFER_SIZE, sizeof(char));
 
-    int bytes_read = recv(client_socket, buffer, BUFFER_SIZE, 0);
+    // Оставляем место под завершающий ноль для strstr в парсерах
+    int bytes_read = recv(client_socket, buffer, BUFFER_SIZE - 1, 0);
     if (bytes_read <= 0) {
         if (bytes_read == 0) {
             printf("Client disconnected before sending request\n");
@@ -264,10 +560,80 @@ void handle_client_request(void* args) {
 
     printf("Request URL: %s\n", url);
 
+    if ((strcmp(url, ADMIN_STATS_PATH) == 0 || strcmp(url, ADMIN_PREFETCH_PATH) == 0) &&
+        !is_admin_peer(client_socket)) {
+        printf("Rejecting admin request from non-loopback client\n");
+        const char* response = "HTTP/1.1 403 Forbidden\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        send_to(client_socket, (void*)response, strlen(response));
+        free(buffer);
+        free(url);
+        close(client_socket);
+        return;
+    }
+
+    if (strcmp(url, ADMIN_STATS_PATH) == 0) {
+        send_stats(client_socket, cache, origins, prefetch);
+        free(buffer);
+        free(url);
+        close(client_socket);
+        return;
+    }
+
+    if (strcmp(url, ADMIN_PREFETCH_PATH) == 0) {
+        handle_prefetch_request(client_socket, buffer, bytes_read, prefetch);
+        free(buffer);
+        free(url);
+        close(client_socket);
+        return;
+    }
+
+    // Кешируем по каноническому ключу: форма запроса, регистр хоста,
+    // порт по умолчанию и порядок параметров не должны плодить копии
+    char* host = extract_host(buffer, MAX_HOST_LEN);
+    char* key = build_cache_key(url, host);
+    if (key == NULL) {
+        printf("Could not build cache key for request\n");
+        free(host);
+        free(url);
+        free(buffer);
+        close(client_socket);
+        return;
+    }
+
+    // Загрузка идёт на хост из заголовка Host, поэтому ключ absolute-form
+    // запроса с другим хостом указывал бы не на тот ответ
+    if (url[0] != '/' && !cache_key_matches_host(key, host)) {
+        printf("Request target %s does not match Host %s, rejecting\n", url, host ? host : "(none)");
+        const char* response = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        send_to(client_socket, (void*)response, strlen(response));
+        free(host);
+        free(url);
+        free(key);
+        free(buffer);
+        close(client_socket);
+        return;
+    }
+    free(host);
+    free(url);
+    url = key;
+
     // Атомарно находим или добавляем URL в кеш
     CacheItem* item = atomic_find_or_add_url(cache, url);
+    if (item == NULL) {
+        printf("All cache slots are in use, fetching without caching\n");
+        pass_through_request(client_socket, origins, buffer);
+        free(buffer);
+        free(url);
+        close(client_socket);
+        return;
+    }
     
     pthread_mutex_lock(&item->elem_mutex);
+
+    // Закешированная ошибка устарела - загружаем заново
+    if (drop_expired_data(item)) {
+        printf("Cached response for %s has expired\n", url);
+    }
     
     if (item->is_loading) {
         // Данные загружаются другим потоком, ждем
@@ -277,10 +643,13 @@ void handle_client_request(void* args) {
             pthread_cond_wait(&item->loading_cond, &item->elem_mutex);
         }
         
-        // Проверяем результат загрузки
+        // Проверяем результат загрузки. Ожидающим отвечаем так же, как
+        // клиенту, запустившему загрузку, а не закрываем соединение молча
         if (item->is_error || item->data->memory == NULL) {
             printf("Error occurred while loading data\n");
             pthread_mutex_unlock(&item->elem_mutex);
+            release_item(item);
+            send_service_unavailable(client_socket);
             free(buffer);
             free(url);
             close(client_socket);
@@ -288,6 +657,7 @@ void handle_client_request(void* args) {
         }
         
         printf("Sending cached data to client\n");
+        count_numa_hit(cache, item);
         if (item->data->size > 0) {
             send_to(client_socket, item->data->memory, item->data->size);
         }
@@ -295,6 +665,7 @@ void handle_client_request(void* args) {
     } else if (item->data->memory != NULL && item->data->size > 0) {
         // Данные уже загружены в кеш
         printf("Sending existing cached data to client\n");
+        count_numa_hit(cache, item);
         send_to(client_socket, item->data->memory, item->data->size);
         
     } else {
@@ -309,6 +680,7 @@ void handle_client_request(void* args) {
         pthread_t tid;
         ThreadArgs* thread_args = (ThreadArgs*)malloc(sizeof(ThreadArgs));
         thread_args->cache = cache;
+        thread_args->origins = origins;
         thread_args->request = strdup(buffer);
         thread_args->client_socket = client_socket;
         thread_args->item = item;
@@ -324,6 +696,7 @@ void handle_client_request(void* args) {
             item->is_error = 1;
             pthread_cond_broadcast(&item->loading_cond);
             pthread_mutex_unlock(&item->elem_mutex);
+            release_item(item);
             
             free(thread_args->request);
             free(thread_args);
@@ -334,21 +707,19 @@ void handle_client_request(void* args) {
         }
         
         pthread_detach(tid);
-        
-        // Ждем завершения загрузки
-        pthread_mutex_lock(&item->elem_mutex);
-        while (item->is_loading) {
-            pthread_cond_wait(&item->loading_cond, &item->elem_mutex);
-        }
-        
-        // Отправляем загруженные данные
-        if (!item->is_error && item->data->memory != NULL && item->data->size > 0) {
-            printf("Sending freshly loaded data to client\n");
-            send_to(client_socket, item->data->memory, item->data->size);
-        }
+
+        // Дальше элемент от вытеснения защищает is_loading
+        release_item(item);
+
+        // Поток загрузки сам отдаёт ответ клиенту и закрывает сокет,
+        // повторная отправка и close здесь попали бы в чужое соединение
+        free(buffer);
+        free(url);
+        return;
     }
     
     pthread_mutex_unlock(&item->elem_mutex);
+    release_item(item);
     
     free(buffer);
     free(url);
@@ -381,10 +752,12 @@ char* extract_url(char* request) {
 }
 
 char* extract_host(const char* request, size_t max_host_len) {
-    const char* host_start = strstr(request, "Host: ");
+    // Ищем заголовок только в начале строки, чтобы не спутать с X-Forwarded-Host
+    const char* host_start = strstr(request, "\r\nHost: ");
     if (!host_start) {
         return NULL;
     }
+    host_start += 2;
 
     const char* host_end = strstr(host_start, "\r\n");
     if (!host_end) {
@@ -413,3 +786,18 @@ int is_response_status_ok(char* buffer) {
            strstr(buffer, "HTTP/1.1 200 OK") != NULL ||
            strstr(buffer, "HTTP/1.1 200") != NULL;
 }
+
+// Код статуса из строки "HTTP/1.x NNN", 0 если не удалось разобрать
+int get_response_status(const char* buffer) {
+    if (strncmp(buffer, "HTTP/", 5) != 0) return 0;
+
+    const char* space = strchr(buffer, ' ');
+    if (space == NULL) return 0;
+
+    int status_code = 0;
+    for (int i = 1; i <= 3; ++i) {
+        if (space[i] < '0' || space[i] > '9') return 0;
+        status_code = status_code * 10 + (space[i] - '0');
+    }
+    return status_code;
+}
@@ -14,25 +14,35 @@
 #include <pthread.h>
 
 #include "cache.h"
+#include "origin.h"
+#include "prefetch.h"
 
 #define MAX_USERS_COUNT 5
 #define PORT 8080
 #define BUFFER_SIZE 4096
 
+#define ADMIN_STATS_PATH "/__proxy/stats"
+#define ADMIN_PREFETCH_PATH "/__proxy/prefetch"
+#define STATS_BUFFER_SIZE (16 * 1024)
+
 struct FuncArgs {
     int client_socket;
     Cache* cache;
+    OriginTable* origins;
+    PrefetchQueue* prefetch;
 };
 
 typedef struct {
     char* request;
     Cache* cache;
-    int client_socket;
+    OriginTable* origins;
+    int client_socket;  // -1 для фоновой загрузки
     CacheItem* item;  
 } ThreadArgs;
 
-int server_socket_init();
+int server_socket_init(int incoming_cpu);
 int is_response_status_ok(char* buffer);
+int get_response_status(const char* buffer);
 char* extract_url(char* request);
 char* extract_host(const char* request, size_t max_host_len);
 
@@ -42,6 +52,9 @@ void handle_client_request(void* args);
 void set_params(struct sockaddr_in* server_addr);
 void binding_and_listening(int server_socket, struct sockaddr_in* server_addr);
 int send_to(int socket, void* data, unsigned int size);
+int is_admin_peer(int client_socket);
+void send_stats(int client_socket, Cache* cache, OriginTable* origins, PrefetchQueue* prefetch);
+void handle_prefetch_request(int client_socket, char* request, size_t request_len, PrefetchQueue* prefetch);
 CacheItem* atomic_find_or_add_url(Cache* cache, const char* url);
 
 #endif //PROXY_H
@@ -1,30 +1,86 @@
 #include "request.h"
 
-int connect_to_remote(const char* host) {
-    struct addrinfo hints, *res0;
+#include <fcntl.h>
+#include <poll.h>
+
+// Неблокирующий connect с ожиданием не дольше timeout_sec
+static int connect_with_timeout(int sock, const struct sockaddr* addr, socklen_t addrlen, int timeout_sec) {
+    int flags = fcntl(sock, F_GETFL, 0);
+    if (flags == -1 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1) return -1;
+
+    int err = connect(sock, addr, addrlen);
+    if (err == -1 && errno != EINPROGRESS) return -1;
+
+    if (err == -1) {
+        struct pollfd pfd = { .fd = sock, .events = POLLOUT };
+        if (poll(&pfd, 1, timeout_sec * 1000) <= 0) return -1;
+
+        int so_error = 0;
+        socklen_t len = sizeof(so_error);
+        if (getsockopt(sock, SOL_SOCKET, SO_ERROR, &so_error, &len) == -1 || so_error != 0) return -1;
+    }
+
+    return fcntl(sock, F_SETFL, flags);
+}
+
+int connect_to_remote(const char* host, int timeout_sec) {
+    struct addrinfo hints, *res0, *res;
     memset(&hints, 0, sizeof hints);
     hints.ai_family = AF_UNSPEC;
     hints.ai_socktype = SOCK_STREAM;
 
-    int status = getaddrinfo(host, "http", &hints, &res0);
-    if (status != 0) return -1;
+    // Host может содержать порт: "example.com:8000" или "[::1]:8000"
+    char name[256];
+    const char* port = "http";
+    if (host[0] == '[') {
+        const char* bracket = strchr(host, ']');
+        if (bracket == NULL || bracket - host - 1 >= (long)sizeof(name)) return -1;
+        if (bracket[1] != '\0' && bracket[1] != ':') return -1;
 
-    int dest_socket = socket(res0->ai_family, res0->ai_socktype, res0->ai_protocol);
-    if (dest_socket == -1) {
-        printf("Error while creating remote server socket\n");
-        freeaddrinfo(res0);
-        return -1;
+        memcpy(name, host + 1, bracket - host - 1);
+        name[bracket - host - 1] = '\0';
+        if (bracket[1] == ':' && bracket[2] != '\0') port = bracket + 2;
+        host = name;
+    } else {
+        const char* colon = strrchr(host, ':');
+        if (colon != NULL && colon - host < (long)sizeof(name)) {
+            memcpy(name, host, colon - host);
+            name[colon - host] = '\0';
+            if (colon[1] != '\0') port = colon + 1;
+            host = name;
+        }
     }
 
-    int err = connect(dest_socket, res0->ai_addr, res0->ai_addrlen);
-    if (err == -1) {
+    int status = getaddrinfo(host, port, &hints, &res0);
+    if (status != 0) return REMOTE_RESOLVE_ERROR;
+
+    int dest_socket = -1;
+    for (res = res0; res != NULL; res = res->ai_next) {
+        dest_socket = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+        if (dest_socket == -1) {
+            printf("Error while creating remote server socket\n");
+            continue;
+        }
+
+        if (connect_with_timeout(dest_socket, res->ai_addr, res->ai_addrlen, timeout_sec) == 0) break;
+
         printf("Error while connecting to remote server socket\n");
         close(dest_socket);
-        freeaddrinfo(res0);
-        return -1;
+        dest_socket = -1;
     }
 
     freeaddrinfo(res0);
 
     return dest_socket;
-}
\ No newline at end of file
+}
+
+int wait_readable(int socket, int timeout_ms) {
+    struct pollfd pfd = { .fd = socket, .events = POLLIN };
+
+    int ready;
+    do {
+        ready = poll(&pfd, 1, timeout_ms);
+    } while (ready == -1 && errno == EINTR);
+
+    return ready;
+}
@@ -4,6 +4,7 @@
 #define _GNU_SOURCE
 #include <arpa/inet.h>
 #include <curl/curl.h>
+#include <errno.h>
 #include <netdb.h>
 #include <netinet/in.h>
 #include <pthread.h>
@@ -20,6 +21,12 @@ typedef struct DataStruct {
     size_t size;
 } Data;
 
-int connect_to_remote(const char* host);
+// connect_to_remote возвращает -1 при ошибке соединения
+// и REMOTE_RESOLVE_ERROR, если не удалось разрешить имя хоста
+#define REMOTE_RESOLVE_ERROR -2
 
-#endif //HTTP_REQUEST_H
\ No newline at end of file
+int connect_to_remote(const char* host, int timeout_sec);
+// 1 - есть данные, 0 - таймаут, -1 - ошибка
+int wait_readable(int socket, int timeout_ms);
+
+#endif //HTTP_REQUEST_H
\ No newline at end of file
@@ -0,0 +1,56 @@
+#include "cache_key.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Вход: "<target>\n<host>". Канонический ключ должен быть неподвижной
+// точкой build_cache_key, иначе один ресурс получит несколько записей
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    char* input = (char*)malloc(size + 1);
+    memcpy(input, data, size);
+    input[size] = '\0';
+
+    char* host = NULL;
+    char* newline = strchr(input, '\n');
+    if (newline != NULL) {
+        *newline = '\0';
+        host = newline + 1;
+    }
+
+    char* key = build_cache_key(input, host);
+    if (key != NULL) {
+        size_t key_len = strlen(key);
+
+        char* again = build_cache_key(key, NULL);
+        if (again == NULL || strcmp(again, key) != 0) {
+            fprintf(stderr, "Key is not canonical: \"%s\" + \"%s\" -> \"%s\" -> \"%s\"\n",
+                    input, host ? host : "(null)", key, again ? again : "(null)");
+            abort();
+        }
+
+        // Равные ключи должны давать равный хеш независимо от того, где лежит
+        // копия: со сдвигом от выравнивания и с мусором после key_len
+        uint64_t key_hash = hash_cache_key(key, key_len);
+        size_t shift = 1 + size % 7;
+        char* shifted = (char*)malloc(shift + key_len + 8);
+        memset(shifted, 0xA5, shift + key_len + 8);
+        memcpy(shifted + shift, again, key_len);
+        if (hash_cache_key(again, key_len) != key_hash ||
+            hash_cache_key(shifted + shift, key_len) != key_hash) {
+            fprintf(stderr, "Equal keys hash differently: \"%s\"\n", key);
+            abort();
+        }
+        free(shifted);
+        free(again);
+
+        // Ключ origin-form запроса должен указывать на хост из Host
+        if (input[0] == '/' && !cache_key_matches_host(key, host)) {
+            fprintf(stderr, "Key does not match its Host: \"%s\" + \"%s\"\n", key, host);
+            abort();
+        }
+    }
+
+    free(key);
+    free(input);
+    return 0;
+}
@@ -0,0 +1,26 @@
+#include "proxy.h"
+
+#include <stdint.h>
+
+// Разбор запроса клиента и статуса ответа сервера: так же, как в
+// handle_client_request, вход обрезается до BUFFER_SIZE - 1 и завершается нулём
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (size > BUFFER_SIZE - 1) size = BUFFER_SIZE - 1;
+
+    char* buffer = (char*)calloc(BUFFER_SIZE, sizeof(char));
+    memcpy(buffer, data, size);
+
+    char* url = extract_url(buffer);
+    if (url != NULL && strlen(url) >= MAX_URL_LEN) abort();
+
+    char* host = extract_host(buffer, MAX_HOST_LEN);
+    if (host != NULL && strlen(host) >= MAX_HOST_LEN) abort();
+
+    int status_code = get_response_status(buffer);
+    if (status_code < 0 || status_code > 999) abort();
+
+    free(url);
+    free(host);
+    free(buffer);
+    return 0;
+}
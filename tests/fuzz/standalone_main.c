@@ -0,0 +1,151 @@
+// Драйвер для сборки без libFuzzer (gcc): прогоняет файлы корпуса, а затем
+// заданное число случайных мутаций этих файлов.
+// Использование: fuzz_xxx <файл или каталог>... [-runs=N] [-seed=N]
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define MAX_SEEDS 256
+#define MAX_INPUT_SIZE 8192
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+typedef struct {
+    uint8_t* data;
+    size_t size;
+} Seed;
+
+static Seed seeds[MAX_SEEDS];
+static int seeds_count = 0;
+
+// Фрагменты, на которых чаще всего ломаются парсеры запросов и ключей
+static const char* tokens[] = {
+    " ", "\r\n", "\r\n\r\n", "\n", "://", "http://", "HTTP/1.1 ", "Host: ",
+    ":", "[", "]", "/", "?", "&", "#", "=", "@", "%", "utm_", "\0"
+};
+
+static void load_file(const char* path) {
+    if (seeds_count == MAX_SEEDS) return;
+
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return;
+    }
+
+    uint8_t* data = (uint8_t*)malloc(MAX_INPUT_SIZE);
+    size_t size = fread(data, 1, MAX_INPUT_SIZE, file);
+    fclose(file);
+
+    LLVMFuzzerTestOneInput(data, size);
+    seeds[seeds_count].data = data;
+    seeds[seeds_count].size = size;
+    seeds_count++;
+}
+
+static void load_path(const char* path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        perror(path);
+        return;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        load_file(path);
+        return;
+    }
+
+    DIR* dir = opendir(path);
+    if (dir == NULL) return;
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+
+        char file_path[4096];
+        snprintf(file_path, sizeof(file_path), "%s/%s", path, entry->d_name);
+        load_file(file_path);
+    }
+    closedir(dir);
+}
+
+static size_t mutate(uint8_t* data, size_t size) {
+    int mutations = 1 + rand() % 8;
+
+    for (int i = 0; i < mutations; ++i) {
+        size_t pos = size > 0 ? (size_t)rand() % (size + 1) : 0;
+
+        switch (rand() % 4) {
+            case 0:  // замена байта
+                if (size > 0 && pos < size) data[pos] = (uint8_t)rand();
+                break;
+            case 1:  // удаление куска
+                if (size > 0 && pos < size) {
+                    size_t len = 1 + (size_t)rand() % (size - pos);
+                    memmove(data + pos, data + pos + len, size - pos - len);
+                    size -= len;
+                }
+                break;
+            case 2: {  // вставка токена
+                const char* token = tokens[rand() % (sizeof(tokens) / sizeof(tokens[0]))];
+                size_t len = token[0] == '\0' ? 1 : strlen(token);
+                if (size + len > MAX_INPUT_SIZE) break;
+                memmove(data + pos + len, data + pos, size - pos);
+                memcpy(data + pos, token, len);
+                size += len;
+                break;
+            }
+            default:  // дублирование куска
+                if (size > 0 && pos < size) {
+                    size_t len = 1 + (size_t)rand() % (size - pos);
+                    if (size + len > MAX_INPUT_SIZE) break;
+                    memmove(data + pos + len, data + pos, size - pos);
+                    size += len;
+                }
+                break;
+        }
+    }
+    return size;
+}
+
+int main(int argc, char* argv[]) {
+    long runs = 10000;
+    unsigned int seed = 1;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "-runs=", 6) == 0) {
+            runs = strtol(argv[i] + 6, NULL, 10);
+        } else if (strncmp(argv[i], "-seed=", 6) == 0) {
+            seed = (unsigned int)strtoul(argv[i] + 6, NULL, 10);
+        } else {
+            load_path(argv[i]);
+        }
+    }
+
+    srand(seed);
+    uint8_t* input = (uint8_t*)malloc(MAX_INPUT_SIZE);
+
+    for (long run = 0; run < runs; ++run) {
+        size_t size = 0;
+        if (seeds_count > 0) {
+            Seed* base = &seeds[rand() % seeds_count];
+            memcpy(input, base->data, base->size);
+            size = base->size;
+        }
+        size = mutate(input, size);
+
+        // Отдельная копия точного размера, чтобы ASan видел выход за границу
+        uint8_t* exact = (uint8_t*)malloc(size > 0 ? size : 1);
+        memcpy(exact, input, size);
+        LLVMFuzzerTestOneInput(exact, size);
+        free(exact);
+    }
+
+    printf("Executed %d corpus inputs and %ld mutations\n", seeds_count, runs);
+
+    free(input);
+    for (int i = 0; i < seeds_count; ++i) free(seeds[i].data);
+    return 0;
+}
@@ -0,0 +1,304 @@
+// Нагрузочный тест кеша: потоки одновременно ищут, добавляют, вытесняют
+// и удаляют элементы, а затем загружают данные через fetch_and_cache_data
+// с локального тестового сервера. Проверяет, что закреплённый элемент не
+// отдают другому ключу и что в кеше лежит тело именно своего ключа.
+// Печатает пропускную способность; запускать стоит и со сборкой
+// -DPROXY_SANITIZER=thread.
+// Использование: stress_cache [секунд на первую фазу]
+#include "proxy.h"
+
+#include <stdarg.h>
+#include <sys/time.h>
+
+#define STRESS_THREADS 8
+#define STRESS_KEYS 8
+#define STRESS_FETCHES_PER_THREAD 6
+
+typedef struct {
+    unsigned int seed;
+    unsigned long ops;
+    unsigned long hits;
+    unsigned long inserts;
+    unsigned long deletes;
+    unsigned long rejected;
+} Worker;
+
+static Cache* cache;
+static OriginTable* origins;
+static char keys[STRESS_KEYS][64];
+static int stop = 0;
+static int failures = 0;
+
+static int stub_socket;
+static int stub_port;
+
+static void fail(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "FAIL: ");
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+
+    __atomic_add_fetch(&failures, 1, __ATOMIC_RELAXED);
+}
+
+static double now_sec() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// Вызывается под elem_mutex закреплённого элемента
+static void check_item(CacheItem* item, const char* key) {
+    if (item->url == NULL || strcmp(item->url, key) != 0) {
+        fail("pinned slot was rebound: expected %s, got %s", key, item->url ? item->url : "(null)");
+        return;
+    }
+
+    size_t key_len = strlen(key);
+    if (item->data->memory != NULL &&
+        (item->data->size < key_len ||
+         memcmp(item->data->memory + item->data->size - key_len, key, key_len) != 0)) {
+        fail("slot for %s holds the body of another key", key);
+    }
+}
+
+// Фаза 1: поиск, вставка, вытеснение и delete_item без сети
+static void* cache_worker(void* arg) {
+    Worker* worker = (Worker*)arg;
+
+    while (!__atomic_load_n(&stop, __ATOMIC_ACQUIRE)) {
+        const char* key = keys[rand_r(&worker->seed) % STRESS_KEYS];
+        worker->ops++;
+
+        if (rand_r(&worker->seed) % 10 == 0) {
+            if (delete_item(key, cache) == 0) {
+                worker->deletes++;
+            } else {
+                worker->rejected++;
+            }
+            continue;
+        }
+
+        CacheItem* item = atomic_find_or_add_url(cache, key);
+        if (item == NULL) {
+            worker->rejected++;
+            continue;
+        }
+
+        pthread_mutex_lock(&item->elem_mutex);
+        while (item->is_loading) {
+            pthread_cond_wait(&item->loading_cond, &item->elem_mutex);
+        }
+        check_item(item, key);
+
+        if (item->data->memory != NULL) {
+            worker->hits++;
+        } else {
+            // Загрузка вне блокировки, как в fetch_and_cache_data
+            item->is_loading = 1;
+            pthread_mutex_unlock(&item->elem_mutex);
+
+            char* body = strdup(key);
+
+            pthread_mutex_lock(&item->elem_mutex);
+            check_item(item, key);
+            if (item->data->memory == NULL) {
+                item->data->memory = body;
+                item->data->size = strlen(body);
+            } else {
+                free(body);
+            }
+            item->is_loading = 0;
+            pthread_cond_broadcast(&item->loading_cond);
+            worker->inserts++;
+        }
+
+        pthread_mutex_unlock(&item->elem_mutex);
+        release_item(item);
+    }
+
+    return NULL;
+}
+
+// Тестовый сервер: отвечает телом, равным цели запроса
+static void* stub_origin(void* arg) {
+    (void)arg;
+
+    while (1) {
+        int client = accept(stub_socket, NULL, NULL);
+        if (client < 0) break;
+
+        char request[BUFFER_SIZE] = {0};
+        size_t len = 0;
+        while (len < sizeof(request) - 1 && strstr(request, "\r\n\r\n") == NULL) {
+            ssize_t bytes_read = read(client, request + len, sizeof(request) - 1 - len);
+            if (bytes_read <= 0) break;
+            len += bytes_read;
+        }
+
+        char* target = extract_url(request);
+        if (target != NULL) {
+            char response[BUFFER_SIZE];
+            int response_len = snprintf(response, sizeof(response),
+                                        "HTTP/1.1 200 OK\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n%s",
+                                        strlen(target), target);
+            send_to(client, response, response_len);
+            free(target);
+        }
+        close(client);
+    }
+
+    return NULL;
+}
+
+static void start_stub_origin(pthread_t* tid) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+
+    stub_socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (stub_socket < 0 ||
+        bind(stub_socket, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(stub_socket, 64) < 0) {
+        perror("Error starting stub origin");
+        exit(1);
+    }
+
+    socklen_t addr_len = sizeof(addr);
+    getsockname(stub_socket, (struct sockaddr*)&addr, &addr_len);
+    stub_port = ntohs(addr.sin_port);
+
+    pthread_create(tid, NULL, &stub_origin, NULL);
+}
+
+// Фаза 2: промахи через настоящий конвейер загрузки
+static void* fetch_worker(void* arg) {
+    Worker* worker = (Worker*)arg;
+
+    for (int i = 0; i < STRESS_FETCHES_PER_THREAD; ++i) {
+        char url[MAX_URL_LEN];
+        snprintf(url, sizeof(url), "http://127.0.0.1:%d/k%u", stub_port, rand_r(&worker->seed) % STRESS_KEYS);
+        char* key = build_cache_key(url, NULL);
+        worker->ops++;
+
+        CacheItem* item = atomic_find_or_add_url(cache, key);
+        if (item == NULL) {
+            worker->rejected++;
+            free(key);
+            continue;
+        }
+
+        pthread_mutex_lock(&item->elem_mutex);
+        while (item->is_loading) {
+            pthread_cond_wait(&item->loading_cond, &item->elem_mutex);
+        }
+        check_item(item, key);
+
+        if (item->data->memory != NULL && item->data->size > 0) {
+            worker->hits++;
+            pthread_mutex_unlock(&item->elem_mutex);
+        } else {
+            item->is_loading = 1;
+            pthread_mutex_unlock(&item->elem_mutex);
+
+            char request[BUFFER_SIZE];
+            snprintf(request, sizeof(request),
+                     "GET %s HTTP/1.1\r\nHost: 127.0.0.1:%d\r\nConnection: close\r\n\r\n", url, stub_port);
+
+            ThreadArgs* args = (ThreadArgs*)malloc(sizeof(ThreadArgs));
+            args->cache = cache;
+            args->origins = origins;
+            args->request = strdup(request);
+            args->client_socket = -1;
+            args->item = item;
+            fetch_and_cache_data(args);
+
+            pthread_mutex_lock(&item->elem_mutex);
+            check_item(item, key);
+            if (item->is_error) fail("fetch of %s failed", key);
+            pthread_mutex_unlock(&item->elem_mutex);
+            worker->inserts++;
+        }
+
+        release_item(item);
+        free(key);
+    }
+
+    return NULL;
+}
+
+static void run_phase(const char* name, void* (*func)(void*), double seconds) {
+    pthread_t threads[STRESS_THREADS];
+    Worker workers[STRESS_THREADS];
+    memset(workers, 0, sizeof(workers));
+
+    __atomic_store_n(&stop, 0, __ATOMIC_RELEASE);
+    double start = now_sec();
+
+    for (int i = 0; i < STRESS_THREADS; ++i) {
+        workers[i].seed = (unsigned int)i * 7919 + 1;
+        pthread_create(&threads[i], NULL, func, &workers[i]);
+    }
+
+    if (seconds > 0) {
+        usleep((useconds_t)(seconds * 1e6));
+        __atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+    }
+
+    Worker total;
+    memset(&total, 0, sizeof(total));
+    for (int i = 0; i < STRESS_THREADS; ++i) {
+        pthread_join(threads[i], NULL);
+        total.ops += workers[i].ops;
+        total.hits += workers[i].hits;
+        total.inserts += workers[i].inserts;
+        total.deletes += workers[i].deletes;
+        total.rejected += workers[i].rejected;
+    }
+
+    double elapsed = now_sec() - start;
+    printf("%s: %lu ops in %.2f s, %.0f ops/s (hits %lu, inserts %lu, deletes %lu, rejected %lu)\n",
+           name, total.ops, elapsed, total.ops / elapsed,
+           total.hits, total.inserts, total.deletes, total.rejected);
+}
+
+int main(int argc, char* argv[]) {
+    double seconds = argc > 1 ? atof(argv[1]) : 2.0;
+
+    signal(SIGPIPE, SIG_IGN);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    for (int i = 0; i < STRESS_KEYS; ++i) {
+        snprintf(keys[i], sizeof(keys[i]), "http://stress.local/k%d", i);
+    }
+
+    cache = (Cache*)aligned_alloc(CACHE_LINE_SIZE, sizeof(Cache));
+    init_cache(cache);
+    origins = (OriginTable*)malloc(sizeof(OriginTable));
+    init_origins(origins);
+
+    run_phase("lookup/insert/evict/delete", &cache_worker, seconds);
+
+    pthread_t stub_tid;
+    start_stub_origin(&stub_tid);
+    run_phase("fetch pipeline", &fetch_worker, 0);
+
+    shutdown(stub_socket, SHUT_RDWR);
+    close(stub_socket);
+    pthread_join(stub_tid, NULL);
+
+    destroy_cache(cache);
+    destroy_origins(origins);
+
+    int failed = __atomic_load_n(&failures, __ATOMIC_RELAXED);
+    if (failed > 0) {
+        fprintf(stderr, "%d check(s) failed\n", failed);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}